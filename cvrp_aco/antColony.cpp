@@ -19,41 +19,114 @@
 #include <assert.h>
 #include <limits.h>
 #include <time.h>
+#include <algorithm>
 
 #include "antColony.h"
 #include "simulatedAnnealing.h"
+#include "parallelTempering.h"
 #include "utilities.h"
 #include "vrpHelper.h"
 #include "problem.h"
 #include "io.h"
 #include "timer.h"
+#include "roulette.h"
 
 AntColony::AntColony(Problem *instance)
 {
     this->instance = instance;
     local_search = new LocalSearch(instance);
     
+    /* 每个线程独立的选择概率数组与随机数流 */
+    num_threads = MAX(instance->num_threads, 1);
+    workers = new AntWorker[num_threads];
+    for (int i = 0; i < num_threads; i++) {
+        workers[i].colony = this;
+        workers[i].id = i;
+        /* 按最大近邻数分配, 子问题重新初始化后无需重新分配 */
+        workers[i].prob_of_selection = new double[MAX_NEIGHBOURS];
+        workers[i].candidate_mask = new int[MAX_NEIGHBOURS];
+        rng_split(&instance->rng, &workers[i].rng);
+        workers[i].local_search = i == 0 ? local_search : new LocalSearch(instance);
+        workers[i].local_search->rng = &workers[i].rng;
+        workers[i].ls_skipped = 0;
+    }
+    pool = num_threads > 1 ? new ThreadPool(num_threads - 1) : NULL;
+    
+    ls_capacity = 0;
+    ls_list = NULL;
+    ls_keys = NULL;
+    tour_hashes = NULL;
+    
+    sync_instance();
+}
+
+/*
+ FUNCTION:       (re)load the data of the instance, has to be called again after
+                 the instance is re-initialized (i.e. a reused sub-problem)
+ INPUT:          none
+ OUTPUT:         none
+ */
+void AntColony::sync_instance(void)
+{
     ants = instance->ants;
     best_so_far_ant = instance->best_so_far_ant;
     
     distance = instance->distance;
-    prob_of_selection = instance->prob_of_selection;
+    arcs = &instance->arcs;
+    heuristic = instance->heuristic;
     pheromone = instance->pheromone;
     total_info = instance->total_info;
+    alias_prob = instance->alias_prob;
+    alias_index = instance->alias_index;
+    alias_dirty = true;
     
     num_node = instance->num_node;
     n_ants = instance->n_ants;
     nn_ants = instance->nn_ants;
+    nn_ext = instance->nn_ext;
     nn_list = instance->nn_list;
+    demand = instance->demand;
+    demand_order = instance->demand_order;
     
     nodeptr = instance->nodeptr;
     vehicle_capacity = instance->vehicle_capacity;
-    ls_flag = instance->ls_flag;
+    max_distance = instance->max_distance;
+    service_time = instance->service_time;
+    config = instance->config;
     
+    /* 问题改变后上次迭代的解不再有意义 */
+    n_tour_hashes = 0;
+    n_ls_list = 0;
+    if (n_ants > ls_capacity) {
+        delete[] ls_list;
+        delete[] ls_keys;
+        delete[] tour_hashes;
+        ls_capacity = n_ants;
+        ls_list = new int[ls_capacity];
+        ls_keys = new double[ls_capacity];
+        tour_hashes = new uint64_t[2 * ls_capacity];    /* 后一半存放本次迭代的hash */
+    }
+    
+    DEBUG( assert(nn_ants <= MAX_NEIGHBOURS); )
+    for (int i = 0; i < num_threads; i++) {
+        workers[i].local_search->sync_instance();
+    }
 }
 
 AntColony::~AntColony(){
+    delete pool;
+    for (int i = 0; i < num_threads; i++) {
+        delete[] workers[i].prob_of_selection;
+        delete[] workers[i].candidate_mask;
+        if (workers[i].local_search != local_search) {
+            delete workers[i].local_search;
+        }
+    }
+    delete[] workers;
     delete local_search;
+    delete[] ls_list;
+    delete[] ls_keys;
+    delete[] tour_hashes;
 }
 
 
@@ -73,7 +146,7 @@ Procedures implementing init/exit aco and aco steps:
  */
 void AntColony::init_aco()
 {
-    instance->best_so_far_time = elapsed_time(REAL);
+    instance->best_so_far_time = elapsed_run_time(instance);
     
     /* Initialize variables concerning statistics etc. */
     instance->iteration   = 0;
@@ -82,29 +155,32 @@ void AntColony::init_aco()
     instance->iter_stagnate_cnt = 0;
     instance->best_stagnate_cnt = 0;
     
+    instance->ls_time = 0;
+    instance->ls_ants = 0;
+    instance->ls_skipped_top_k = 0;
+    instance->ls_skipped_changed = 0;
+    instance->ls_skipped_budget = 0;
+    
     /* Initialize the Pheromone trails */
     /* in the original papers on Ant System, Elitist Ant System, and
      Rank-based Ant System it is not exactly defined what the
      initial value of the pheromones is. Here we set it to some
      small constant, analogously as done in MAX-MIN Ant System.
      */
+    /* init_pheromone_trails also computes the combined information
+     pheromone times heuristic information */
     double trail_0 = 0.5;
     init_pheromone_trails(trail_0);
-    compute_total_information();
     
     // 第一次迭代用于设置一个合适的 pheromone init trail
     construct_solutions();
-    if (ls_flag) {
-        local_search->do_local_search();
+    if (config.ls_flag) {
+        do_local_search();
     }
     update_statistics();
-    trail_0 =  1.0 / ((rho) * best_so_far_ant->tour_length);
+    trail_0 =  1.0 / ((config.rho) * best_so_far_ant->tour_length);
     init_pheromone_trails(trail_0);
     instance->iteration++;
-    
-    /* Calculate combined information pheromone times heuristic information */
-    compute_total_information();
-    
 }
 
 /*
@@ -122,23 +198,32 @@ void AntColony::run_aco_iteration()
 {
     construct_solutions();
     
-    if (ls_flag) {
-        local_search->do_local_search();
+    if (config.ls_flag) {
+        do_local_search();
     }
     
     update_statistics();
     
     pheromone_trail_update();
     
-    if (sa_flag) {
-        if ((instance->pid == 0 && instance->best_stagnate_cnt >= instance->num_node)
-            || (instance->pid != 0 && instance->best_stagnate_cnt >= 30))
+    if (config.sa_flag) {
+        /* 岛(pid < 0)求解的是整个实例, 与主问题使用相同的停滞阈值; 子问题(pid > 0)为30 */
+        if ((instance->pid <= 0 && instance->best_stagnate_cnt >= instance->num_node)
+            || (instance->pid > 0 && instance->best_stagnate_cnt >= 30))
         {
-            SimulatedAnnealing *annealer = new SimulatedAnnealing(instance, this, 5.0, 0.97, MAX(instance->num_node * 4, 250), 50);
-            annealer->run();
-            instance->best_stagnate_cnt = 0;
+            int n_replicas = MIN(config.sa_replicas, num_threads);
             
-            delete annealer;
+            if (n_replicas > 1) {
+                ParallelTempering *tempering = new ParallelTempering(instance, this, n_replicas, 5.0, config.sa_ladder_ratio,
+                                                                     0.97, MAX(instance->num_node * 4, 250), 50);
+                tempering->run();
+                delete tempering;
+            } else {
+                SimulatedAnnealing *annealer = new SimulatedAnnealing(instance, this, 5.0, 0.97, MAX(instance->num_node * 4, 250), 50);
+                annealer->run();
+                delete annealer;
+            }
+            instance->best_stagnate_cnt = 0;
         }
     }
 }
@@ -149,74 +234,210 @@ void AntColony::run_aco_iteration()
  OUTPUT:         none
  (SIDE)EFFECTS:  when finished, all ants of the colony have constructed a solution
  */
-void AntColony::construct_solutions( void )
+static void *construct_handle(void *in)
 {
-    int k;
+    AntWorker *worker = (AntWorker *)in;
+    AntColony *colony = worker->colony;
     
+    for (int k = worker->id; k < colony->n_ants; k += colony->num_threads) {
+        colony->construct_ant_solution(&colony->ants[k], worker);
+    }
+    return NULL;
+}
+
+/*
+ * 线程函数: 重建分配给该线程的点(id, id + num_threads, ...)的 alias table
+ */
+static void *alias_handle(void *in)
+{
+    AntWorker *worker = (AntWorker *)in;
+    AntColony *colony = worker->colony;
+    
+    for (int i = worker->id; i < colony->num_node; i += colony->num_threads) {
+        colony->build_alias_table(i, worker);
+    }
+    return NULL;
+}
+
+void AntColony::construct_solutions( void )
+{
     TRACE ( printf("construct solutions for all ants\n"); );
 
-    for(k = 0; k < n_ants; k++) {
-        construct_ant_solution(&ants[k]);
+    /* 上次构造之后信息素有更新时才重建 alias table */
+    if (config.alias_flag && alias_dirty) {
+        run_workers(alias_handle);
+        alias_dirty = false;
+    }
+    run_workers(construct_handle);
+}
+
+/*
+ * FNV-1a hash of a tour
+ */
+static uint64_t tour_hash(const int *tour, int tour_size)
+{
+    const uint64_t prime = ((uint64_t)0x100 << 32) | 0x000001b3;
+    uint64_t h = ((uint64_t)0xcbf29ce4 << 32) | 0x84222325;
+    
+    for (int i = 0; i < tour_size; i++) {
+        h = (h ^ (uint64_t)tour[i]) * prime;
+    }
+    return h;
+}
+
+/*
+ FUNCTION:       choose the ants that local search is applied to, according to
+                 config.ls_policy
+ INPUT:          none
+ OUTPUT:         number of chosen ants
+ (SIDE)EFFECTS:  ls_list holds the chosen ants, shortest tour first;
+                 tour_hashes holds the hashes of all tours of this iteration;
+                 the skip counters of the instance are updated
+ */
+int AntColony::select_local_search_ants( void )
+{
+    int k, n = 0;
+    uint64_t *cur_hashes = tour_hashes + ls_capacity;
+    
+    for (k = 0; k < n_ants; k++) {
+        if (config.ls_policy & LS_POLICY_CHANGED) {
+            /* 上次迭代构造出过相同的解, 其local search结果已经用于更新信息素 */
+            cur_hashes[k] = tour_hash(ants[k].tour, ants[k].tour_size);
+            if (std::binary_search(tour_hashes, tour_hashes + n_tour_hashes, cur_hashes[k])) {
+                instance->ls_skipped_changed++;
+                continue;
+            }
+        }
+        ls_list[n++] = k;
+    }
+    
+    if (config.ls_policy & LS_POLICY_CHANGED) {
+        std::copy(cur_hashes, cur_hashes + n_ants, tour_hashes);
+        std::sort(tour_hashes, tour_hashes + n_ants);
+        n_tour_hashes = n_ants;
+    }
+    
+    if (config.ls_policy & (LS_POLICY_TOP_K | LS_POLICY_BUDGET)) {
+        for (k = 0; k < n; k++) {
+            ls_keys[k] = ants[ls_list[k]].tour_length;
+        }
+        sort2(ls_keys, ls_list, 0, n - 1);
+    }
+    if ((config.ls_policy & LS_POLICY_TOP_K) && n > config.ls_top_k) {
+        instance->ls_skipped_top_k += n - config.ls_top_k;
+        n = config.ls_top_k;
+    }
+    return n;
+}
+
+/*
+ FUNCTION:       apply local search to the ants in ls_list, the ants are
+                 distributed over the worker threads in the same way as in
+                 construct_solutions
+ INPUT:          none
+ OUTPUT:         none
+ (SIDE)EFFECTS:  the chosen ants have locally optimal tours; with
+                 LS_POLICY_BUDGET, or when the run's deadline is reached,
+                 the remaining ants are skipped
+ */
+static void *local_search_handle(void *in)
+{
+    AntWorker *worker = (AntWorker *)in;
+    AntColony *colony = worker->colony;
+    AntStruct *ant;
+    bool budget_flag = colony->config.ls_policy & LS_POLICY_BUDGET;
+    
+    worker->ls_skipped = 0;
+    for (int i = worker->id; i < colony->n_ls_list; i += colony->num_threads) {
+        if ((budget_flag && coarse_clock() >= colony->ls_end_time)
+            || deadline_expired(colony->instance->deadline)) {
+            worker->ls_skipped = (colony->n_ls_list - i + colony->num_threads - 1) / colony->num_threads;
+            break;
+        }
+        ant = &colony->ants[colony->ls_list[i]];
+        worker->local_search->do_local_search(ant);
+        DEBUG(assert(check_solution(colony->instance, ant->tour, ant->tour_size));)
+    }
+    return NULL;
+}
+
+void AntColony::do_local_search( void )
+{
+    int skipped = 0;
+    
+    TRACE ( printf("apply local search to ants\n"); );
+    
+    ls_start_time = real_clock();
+    ls_end_time = coarse_clock() + config.ls_time_budget;
+    n_ls_list = select_local_search_ants();
+    run_workers(local_search_handle);
+    
+    for (int i = 0; i < num_threads; i++) {
+        skipped += workers[i].ls_skipped;
+    }
+    instance->ls_skipped_budget += skipped;
+    instance->ls_ants += n_ls_list - skipped;
+    instance->ls_time += real_clock() - ls_start_time;
+}
+
+/*
+ FUNCTION:       run handle on all workers and wait until all of them are done;
+                 workers[0] runs in the calling thread
+ INPUT:          thread function, its argument is the AntWorker
+ OUTPUT:         none
+ */
+void AntColony::run_workers(void *(*handle)(void *))
+{
+    int i;
+    
+    for (i = 1; i < num_threads; i++) {
+        pool->submit(handle, (void *)&workers[i]);
+    }
+    
+    handle((void *)&workers[0]);
+    
+    if (pool != NULL) {
+        pool->wait();
     }
 }
 
 /*
  FUNCTION:       construct the solution for this ant
- INPUT:          this ant id
+ INPUT:          this ant, the worker thread constructing it
  OUTPUT:         none
  (SIDE)EFFECTS:  when finished, this ant has constructed a solution
  */
 
-void AntColony::construct_ant_solution(AntStruct *ant)
+void AntColony::construct_ant_solution(AntStruct *ant, AntWorker *worker)
 {
-    int visited_cnt = 0;   /* count of visited node by this ant */
-    
-    int route_load;          /* 单次从depot出发的送货量 */
     int next_node, current_node;
-    int i, step;
-    double route_dist;
-    bool candidate_flag;
+    int step;
     
     /* Mark all nodes as unvisited */
     ant_empty_memory(ant);
     
-    route_load = 0;
-    route_dist = 0;
     step = 0;
     init_ant_place(ant, step);
     
-    while (visited_cnt < num_node - 1) {
+    while (ant->n_unvisited > 0) {
         current_node = ant->tour[step];
         step++;
         
-        /* 查看所有可以派送的点 */
-        candidate_flag = FALSE;
-        for (i = 0; i < num_node; i++) {
-            ant->candidate[i] = FALSE;
-        }
-        for(i = 0; i < num_node; i++) {
-            if (ant->visited[i] == FALSE
-                && route_load + nodeptr[i].demand <= vehicle_capacity
-                && route_dist + (distance[current_node][i] + instance->service_time) + distance[i][0] <= instance->max_distance) {
-                ant->candidate[i] = TRUE;
-                candidate_flag = TRUE;
-            }
-        }
-        
         /*
          1)如果没有可行的配送点,则蚂蚁回到depot，重新开始新的路径
          2）否则，选择下一个配送点
          */
-        if (!candidate_flag) {
-            route_load = 0;
-            route_dist = 0;
+        if (config.alias_flag) {
+            next_node = alias_choose_and_move_to_next(ant, step, worker);
+        } else {
+            next_node = neighbour_choose_and_move_to_next(ant, step, worker);
+        }
+        if (next_node == num_node) {
             init_ant_place(ant, step);
         } else {
-            next_node = neighbour_choose_and_move_to_next(ant, step);
-            route_load += nodeptr[next_node].demand;
-            route_dist += distance[current_node][next_node] + instance->service_time;
-            ant->visited[next_node] = TRUE;
-            visited_cnt++;
+            ant->route_load += nodeptr[next_node].demand;
+            ant->route_dist += distance(current_node, next_node) + service_time;
+            visit_node(ant, next_node);
         }
     }
     
@@ -252,7 +473,7 @@ void AntColony::ras_update( void )
     for ( k = 0 ; k < n_ants ; k++ )
         help_b[k] = ants[k].tour_length;
     
-    for ( i = 0 ; i < ras_ranks-1 ; i++ ) {
+    for ( i = 0 ; i < config.ras_ranks-1 ; i++ ) {
         b = help_b[0]; target = 0;
         for ( k = 0 ; k < n_ants ; k++ ) {
             if ( help_b[k] < b ) {
@@ -261,9 +482,9 @@ void AntColony::ras_update( void )
             }
         }
         help_b[target] = INFINITY;
-        global_update_pheromone_weighted(&ants[target], ras_ranks-i-1);
+        global_update_pheromone_weighted(&ants[target], config.ras_ranks-i-1);
     }
-    global_update_pheromone_weighted(best_so_far_ant, ras_ranks);
+    global_update_pheromone_weighted(best_so_far_ant, config.ras_ranks);
     free ( help_b );
 }
 
@@ -277,22 +498,19 @@ void AntColony::pheromone_disturbance(void)
     printf("pid %d start pheromone disturbance: iter %d, best_stagnate %d, iter_stagnate %d\n",
            instance->pid, instance->iteration, instance->best_stagnate_cnt, instance->iter_stagnate_cnt);
     
-    int i, j;
+    int s;
     double sum_pheromone = 0, mean_pheromone;
     double delta = 0.7;
     
-    for (i = 0; i < num_node; i++) {
-        for (j = 0; j < num_node; j++) {
-            sum_pheromone += pheromone[i][j];
-        }
+    for (s = 0; s < arcs->size; s++) {
+        sum_pheromone += pheromone[s];
     }
     
-    mean_pheromone = sum_pheromone / (num_node * num_node);
+    mean_pheromone = sum_pheromone / arcs->size;
     
-    for (i = 0; i < num_node; i++) {
-        for (j = 0; j < num_node; j++) {
-            pheromone[i][j] = (1- delta) * mean_pheromone + delta * pheromone[i][j];
-        }
+    for (s = 0; s < arcs->size; s++) {
+        pheromone[s] = (1- delta) * mean_pheromone + delta * pheromone[s];
+        update_total_information(s);
     }
     
 //    print_pheromone(instance);
@@ -310,7 +528,7 @@ void AntColony::pheromone_trail_update( void )
 {
     /* Simulate the pheromone evaporation of all pheromones; this is not necessary
      for ACS (see also ACO Book) */
-    if (ls_flag) {
+    if (config.ls_flag) {
         evaporation_nn_list();
         /* evaporate only pheromones on arcs of candidate list to make the
          pheromone evaporation faster for being able to tackle large TSP
@@ -330,14 +548,9 @@ void AntColony::pheromone_trail_update( void )
         /* Next, apply the pheromone deposit for the various ACO algorithms */
         ras_update();
     }
-    /* Compute combined information pheromone times heuristic info after
-     the pheromone update for all ACO algorithms except ACS; in the ACS case
-     this is already done in the pheromone update procedures of ACS */
-    if (ls_flag) {
-        compute_nn_list_total_information();
-    } else {
-        compute_total_information();
-    }
+    /* The combined information pheromone times heuristic info is updated
+     together with the pheromones by evaporation, deposit and disturbance,
+     so no separate pass over the arcs is needed */
 }
 
 /*
@@ -360,7 +573,7 @@ void AntColony::update_statistics()
         // 获得更优解
         instance->best_stagnate_cnt = 0;
         
-        instance->best_so_far_time = elapsed_time( REAL );
+        instance->best_so_far_time = elapsed_run_time(instance);
         copy_solution_from_to(instance->iteration_best_ant, best_so_far_ant );
         
         instance->best_solution_iter = instance->iteration;
@@ -447,20 +660,27 @@ void AntColony::init_pheromone_trails( double initial_trail )
       FUNCTION:      initialize pheromone trails
       INPUT:         initial value of pheromone trails "initial_trail"
       OUTPUT:        none
-      (SIDE)EFFECTS: pheromone matrix is reinitialized
+      (SIDE)EFFECTS: pheromone matrix is reinitialized, total information is
+                     recomputed
+      COMMENTS:      arcs not stored in a sparse layout keep the initial trail
+                     and carry no total information
 */
 {
-    int i, j;
+    int s;
+    double trail_alpha;
 
     TRACE ( printf(" init trails with %.15f\n",initial_trail); );
 
+    trail_alpha = config.alpha == 1.0 ? initial_trail : pow(initial_trail, config.alpha);
+    
     /* Initialize pheromone trails */
-    for ( i = 0 ; i < num_node ; i++ ) {
-        for ( j = 0 ; j < num_node ; j++ ) {
-//            if(j == i) continue;
-            pheromone[i][j] = initial_trail;
-        }
+    for ( s = 0 ; s < arcs->size ; s++ ) {
+        pheromone[s] = initial_trail;
+        total_info[s] = trail_alpha * heuristic[s];
     }
+    pheromone[arcs->size] = initial_trail;
+    total_info[arcs->size] = 0.;
+    alias_dirty = true;
 }
 
 
@@ -470,18 +690,17 @@ void AntColony::evaporation( void )
       FUNCTION:      implements the pheromone trail evaporation
       INPUT:         none
       OUTPUT:        none
-      (SIDE)EFFECTS: pheromones are reduced by factor rho
+      (SIDE)EFFECTS: pheromones are reduced by factor rho, total information
+                     is updated in the same pass
 */
 { 
-    int    i, j;
+    int    s;
 
     TRACE ( printf("pheromone evaporation\n"); );
 
-    for ( i = 0 ; i < num_node ; i++ ) {
-        for ( j = 0 ; j < num_node ; j++ ) {
-            if(j == i) continue;
-            pheromone[i][j] = (1 - rho) * pheromone[i][j];
-        }
+    for ( s = 0 ; s < arcs->size ; s++ ) {
+        pheromone[s] = (1 - config.rho) * pheromone[s];
+        update_total_information(s);
     }
 }
 
@@ -492,20 +711,22 @@ void AntColony::evaporation_nn_list( void )
       FUNCTION:      simulation of the pheromone trail evaporation
       INPUT:         none
       OUTPUT:        none
-      (SIDE)EFFECTS: pheromones are reduced by factor rho
+      (SIDE)EFFECTS: pheromones are reduced by factor rho, total information
+                     is updated in the same pass
       REMARKS:       if local search is used, this evaporation procedure 
                      only considers links between a node and those nodes
 		     of its candidate list
 */
 { 
-    int    i, j, help_node;
+    int    i, j, s;
 
     TRACE ( printf("pheromone evaporation nn_list\n"); );
 
     for ( i = 0 ; i < num_node ; i++ ) {
         for ( j = 0 ; j < nn_ants ; j++ ) {
-            help_node = nn_list[i][j];
-            pheromone[i][help_node] = (1 - rho) * pheromone[i][help_node];
+            s = arcs->nn_slot(i, j);
+            pheromone[s] = (1 - config.rho) * pheromone[s];
+            update_total_information(s);
         }
     }
 }
@@ -517,20 +738,11 @@ void AntColony::global_update_pheromone( AntStruct *a )
       FUNCTION:      reinforces edges used in ant k's solution
       INPUT:         pointer to ant that updates the pheromone trail 
       OUTPUT:        none
-      (SIDE)EFFECTS: pheromones of arcs in ant k's tour are increased
+      (SIDE)EFFECTS: pheromones of arcs in ant k's tour are increased,
+                     total information of these arcs is updated
 */
 {  
-    int i, j, h;
-    double   d_tau;
-
-    TRACE ( printf("global pheromone update\n"); );
-
-    d_tau = 1.0 / (double) a->tour_length;
-    for ( i = 0 ; i < a->tour_size-1 ; i++ ) {
-        j = a->tour[i];
-        h = a->tour[i+1];
-        pheromone[j][h] += d_tau;
-    }
+    global_update_pheromone_weighted(a, 1);
 }
 
 
@@ -540,19 +752,24 @@ void AntColony::global_update_pheromone_weighted( AntStruct *a, int weight )
       FUNCTION:      reinforces edges of the ant's tour with weight "weight"
       INPUT:         pointer to ant that updates pheromones and its weight  
       OUTPUT:        none
-      (SIDE)EFFECTS: pheromones of arcs in the ant's tour are increased
+      (SIDE)EFFECTS: pheromones of arcs in the ant's tour are increased,
+                     total information of these arcs is updated
+      REMARKS:       in a sparse layout, arcs outside the candidate lists are
+                     not stored and do not receive pheromone
 */
 {  
-    int      i, j, h;
+    int      i, s;
     double        d_tau;
 
     TRACE ( printf("global pheromone update weighted\n"); );
 
     d_tau = (double) weight / (double) a->tour_length;
     for ( i = 0 ; i < a->tour_size-1 ; i++ ) {
-        j = a->tour[i];
-        h = a->tour[i+1];
-        pheromone[j][h] += d_tau;
+        s = arcs->slot(a->tour[i], a->tour[i+1]);
+        if (s >= 0) {
+            pheromone[s] += d_tau;
+            update_total_information(s);
+        }
     }       
 }
 
@@ -565,14 +782,18 @@ void AntColony::compute_total_information( void )
       OUTPUT:   none
 */
 {
-    int     i, j;
+    int     s;
 
     TRACE ( printf("compute total information\n"); );
 
-    for ( i = 0 ; i < num_node ; i++ ) {
-        for ( j = 0 ; j < num_node; j++ ) {
-            if(j == i) continue;
-            total_info[i][j] = pow(pheromone[i][j], alpha) * pow(HEURISTIC(i,j), beta);
+    alias_dirty = true;
+    if (config.alpha == 1.0) {
+        for ( s = 0 ; s < arcs->size ; s++ ) {
+            total_info[s] = pheromone[s] * heuristic[s];
+        }
+    } else {
+        for ( s = 0 ; s < arcs->size ; s++ ) {
+            total_info[s] = pow(pheromone[s], config.alpha) * heuristic[s];
         }
     }
 }
@@ -586,14 +807,13 @@ void AntColony::compute_nn_list_total_information( void )
       OUTPUT:   none
 */
 { 
-    int    i, j, h;
+    int    i, j;
 
     TRACE ( printf("compute total information nn_list\n"); );
 
     for ( i = 0 ; i < num_node ; i++ ) {
         for ( j = 0 ; j < nn_ants ; j++ ) {
-            h = nn_list[i][j];
-            total_info[i][h] = pow(pheromone[i][h], alpha) * pow(HEURISTIC(i,h),beta);
+            update_total_information(arcs->nn_slot(i, j));
         }
     }
 }
@@ -613,14 +833,13 @@ void AntColony::ant_empty_memory( AntStruct *a )
       FUNCTION:       empty the ants's memory regarding visited nodes
       INPUT:          ant identifier
       OUTPUT:         none
-      (SIDE)EFFECTS:  vector of visited nodes is reinitialized to FALSE
+      (SIDE)EFFECTS:  all nodes are unvisited again
+      COMMENTS:       a->unvisited always holds a permutation of all nodes except
+                      the depot, so resetting n_unvisited is enough
 */
 {
-    int   i;
-
-    for( i = 0 ; i < num_node ; i++ ) {
-        a->visited[i]=FALSE;
-    }
+    a->n_unvisited = num_node - 1;
+    a->min_demand_pos = 0;
     a->tour_size = 0;
 }
 
@@ -631,11 +850,35 @@ void AntColony::init_ant_place( AntStruct *a , int phase)
       FUNCTION:      place an ant on the single depot
       INPUT:         pointer to ant and the number of construction steps 
       OUTPUT:        none
-      (SIDE)EFFECT:  ant is put on the depot
+      (SIDE)EFFECT:  ant is put on the depot, a new route is started
 */
 {
     a->tour[phase] = 0;
-    a->visited[0] = TRUE;
+    a->route_load = 0;
+    a->route_dist = 0;
+}
+
+
+
+void AntColony::visit_node( AntStruct *a, int node )
+/*    
+      FUNCTION:      mark node as visited
+      INPUT:         pointer to ant and the visited node
+      OUTPUT:        none
+      (SIDE)EFFECT:  node is swapped to the end of the unvisited nodes, O(1)
+*/
+{
+    int pos, last;
+    
+    DEBUG( assert ( a->unvisited_pos[node] < a->n_unvisited ); )
+    a->n_unvisited--;
+    pos = a->unvisited_pos[node];
+    last = a->unvisited[a->n_unvisited];
+    
+    a->unvisited[pos] = last;
+    a->unvisited_pos[last] = pos;
+    a->unvisited[a->n_unvisited] = node;
+    a->unvisited_pos[node] = a->n_unvisited;
 }
 
 
@@ -645,32 +888,30 @@ int AntColony::choose_best_next( AntStruct *a, int phase )
       FUNCTION:      chooses for an ant as the next node the one with
                      maximal value of heuristic information times pheromone 
       INPUT:         pointer to ant and the construction step
-      OUTPUT:        none 
+      OUTPUT:        the chosen node, num_node if no node is feasible
       (SIDE)EFFECT:  ant moves to the chosen node
+      COMMENTS:      only the unvisited nodes are scanned
 */
 { 
-    int node, current_node, next_node;
+    int i, node, current_node, next_node;
     double   value_best;
 
     next_node = num_node;
     DEBUG( assert ( phase > 0 && phase < 2*num_node-2 ); );
     current_node = a->tour[phase-1];
     value_best = -1.;             /* values in total matrix are always >= 0.0 */    
-    for ( node = 0 ; node < num_node ; node++ ) {
-        if(a->candidate[node] == FALSE) {
-            ;  /* 该点不满足要求 */
-        } else {
-            if ( total_info[current_node][node] > value_best ) {
-                next_node = node;
-                value_best = total_info[current_node][node];
-            }
+    for ( i = 0 ; i < a->n_unvisited ; i++ ) {
+        node = a->unvisited[i];
+        if ( is_candidate(a, current_node, node)
+            && arcs->value(total_info, current_node, node) > value_best ) {
+            next_node = node;
+            value_best = arcs->value(total_info, current_node, node);
         }
     }
-    DEBUG( assert ( 0 <= next_node && next_node < num_node));
-    DEBUG( assert ( value_best > 0.0 ); )
-    DEBUG( assert ( a->visited[next_node] == FALSE ); )
-    a->tour[phase] = next_node;
-    
+    if ( next_node != num_node ) {
+        DEBUG( assert ( value_best > 0.0 ); )
+        a->tour[phase] = next_node;
+    }
     return next_node;
 }
 
@@ -681,7 +922,7 @@ int AntColony::neighbour_choose_best_next( AntStruct *a, int phase )
       FUNCTION:      chooses for an ant as the next node the one with
                      maximal value of heuristic information times pheromone 
       INPUT:         pointer to ant and the construction step "phase" 
-      OUTPUT:        none 
+      OUTPUT:        the chosen node, num_node if no node is feasible
       (SIDE)EFFECT:  ant moves to the chosen node
 */
 { 
@@ -695,10 +936,8 @@ int AntColony::neighbour_choose_best_next( AntStruct *a, int phase )
     value_best = -1.;             /* values in total matix are always >= 0.0 */    
     for ( i = 0 ; i < nn_ants ; i++ ) {
         help_node = nn_list[current_node][i];
-        if(a->candidate[help_node] == FALSE) {
-            ;  /* 该点不满足要求 */
-        } else {
-            help = total_info[current_node][help_node];
+        if ( is_candidate(a, current_node, help_node) ) {
+            help = total_info[arcs->nn_slot(current_node, i)];
             if ( help > value_best ) {
                 value_best = help;
                 next_node = help_node;
@@ -707,11 +946,10 @@ int AntColony::neighbour_choose_best_next( AntStruct *a, int phase )
     }
     if ( next_node == num_node )
 	/* all nodes in nearest neighbor list were already visited */
-        choose_best_next( a, phase );
+        return neighbour_choose_closest_next( a, phase );
     else {
         DEBUG( assert ( 0 <= next_node && next_node < num_node); )
         DEBUG( assert ( value_best > 0.0 ); )
-        DEBUG( assert ( a->visited[next_node] == FALSE ); )
         a->tour[phase] = next_node;
     }
     return next_node;
@@ -719,85 +957,131 @@ int AntColony::neighbour_choose_best_next( AntStruct *a, int phase )
 
 
 
-void AntColony::choose_closest_next( AntStruct *a, int phase )
+int AntColony::choose_closest_next( AntStruct *a, int phase )
 /*    
       FUNCTION:      Chooses for an ant the closest node as the next one 
       INPUT:         pointer to ant and the construction step "phase" 
-      OUTPUT:        none 
+      OUTPUT:        the chosen node, num_node if no node is feasible
       (SIDE)EFFECT:  ant moves to the chosen node
 */
 { 
-    int node, current_node, next_node;
+    int i, node, current_node, next_node;
     double min_distance;
   
     next_node = num_node;
     DEBUG( assert ( phase > 0 && phase < 2*num_node-2 ); );
     current_node = a->tour[phase-1];
     min_distance = INFINITY;             /* Search shortest edge */    
-    for ( node = 0 ; node < num_node ; node++ ) {
-        if(a->candidate[node] == FALSE) {
-            ;  /* 该点不满足要求 */
-        } else {
-            if ( distance[current_node][node] < min_distance) {
-                next_node = node;
-                min_distance = distance[current_node][node];
-            }
-        } 
+    for ( i = 0 ; i < a->n_unvisited ; i++ ) {
+        node = a->unvisited[i];
+        if ( is_candidate(a, current_node, node)
+            && distance(current_node, node) < min_distance ) {
+            next_node = node;
+            min_distance = distance(current_node, node);
+        }
+    }
+    if ( next_node != num_node ) {
+        a->tour[phase] = next_node;
     }
-    DEBUG( assert ( 0 <= next_node && next_node < num_node); );
-    a->tour[phase] = next_node;
+    return next_node;
 }
 
 
-int AntColony::neighbour_choose_and_move_to_next(AntStruct *a, int phase)
+
+int AntColony::neighbour_choose_closest_next( AntStruct *a, int phase )
+/*    
+      FUNCTION:      Chooses for an ant the closest feasible node in the extended
+                     nearest neighbor list, used when no node of the candidate
+                     list is feasible
+      INPUT:         pointer to ant and the construction step "phase" 
+      OUTPUT:        the chosen node, num_node if no node is feasible
+      (SIDE)EFFECT:  ant moves to the chosen node
+      COMMENTS:      the unvisited nodes are only scanned if the extended list
+                     is exhausted and the remaining capacity still fits the
+                     smallest unvisited demand
+*/
+{ 
+    int i, current_node, help_node;
+  
+    DEBUG( assert ( phase > 0 && phase < 2*num_node-2 ); );
+    current_node = a->tour[phase-1];
+    
+    /* nn_list is sorted by distance, the first feasible node is the closest one */
+    for ( i = nn_ants ; i < nn_ext ; i++ ) {
+        help_node = nn_list[current_node][i];
+        if ( is_candidate(a, current_node, help_node) ) {
+            a->tour[phase] = help_node;
+            return help_node;
+        }
+    }
+    
+    /* 剩余需求量最小的点也超过车辆剩余装载量, 则只能回到depot */
+    while ( a->min_demand_pos < num_node - 1
+           && a->unvisited_pos[demand_order[a->min_demand_pos]] >= a->n_unvisited ) {
+        a->min_demand_pos++;
+    }
+    if ( a->min_demand_pos == num_node - 1
+        || a->route_load + nodeptr[demand_order[a->min_demand_pos]].demand > vehicle_capacity ) {
+        return num_node;
+    }
+    
+    return choose_closest_next( a, phase );
+}
+
+
+int AntColony::neighbour_choose_and_move_to_next(AntStruct *a, int phase, AntWorker *worker)
 /*    
      FUNCTION:      Choose for an ant probabilistically a next node among all
      unvisited and possible nodes in the current node's candidate list.
      If this is not possible, choose the closest next
-     INPUT:         pointer to ant the construction step "phase"
-     OUTPUT:        none
+     INPUT:         pointer to ant the construction step "phase", the worker
+                    thread providing selection buffer and random seed
+     OUTPUT:        the chosen node, num_node if no node is feasible
      (SIDE)EFFECT:  ant moves to the chosen node
 */
 {
     int i, help;
-    int current_node, neighbour_node;
-    double   rnd, partial_sum = 0., sum_prob = 0.0;
+    int current_node;
+    double   rnd, sum_prob;
     /*  double   *prob_of_selection; */ /* stores the selection probabilities 
 	of the nearest neighbor nodes */
     double   *prob_ptr;
+    int      *mask;
+    int      *nn_col;       /* position of the candidate arcs in the total_info row */
+    int      *nn_row;
+    real_t   *info_row;
 
-    prob_ptr = prob_of_selection;
+    prob_ptr = worker->prob_of_selection;
+    mask = worker->candidate_mask;
 
     current_node = a->tour[phase-1]; /* current_node node of ant k */
     DEBUG( assert ( current_node >= 0 && current_node < num_node ); )
-    for ( i = 0 ; i < nn_ants ; i++ ) {
-        neighbour_node = nn_list[current_node][i];
-        if(a->candidate[neighbour_node] == FALSE) {
-            prob_ptr[i] = 0.0;  /* 该点不满足要求 */
-        } else {
-            DEBUG( assert ( neighbour_node >= 0 && neighbour_node < num_node ); )
-            prob_ptr[i] = total_info[current_node][neighbour_node];
-            sum_prob += prob_ptr[i];
-        } 
+    nn_col = arcs->nn_col[current_node];
+    info_row = total_info + current_node * arcs->width;
+    nn_row = nn_list[current_node];
+    /* 先求出可行的近邻(同 is_candidate), 再读取它们的 total_info 并求和, 两步都是向量化的 */
+    roulette_mask(nn_row, a->unvisited_pos, a->n_unvisited, demand,
+                  vehicle_capacity - a->route_load, mask, nn_ants);
+    if (max_distance < INFINITY) {
+        for ( i = 0 ; i < nn_ants ; i++ ) {
+            if (mask[i] && !is_candidate(a, current_node, nn_row[i])) {
+                mask[i] = 0;
+            }
+        }
     }
+    sum_prob = roulette_weights(info_row, nn_col, mask, prob_ptr, nn_ants);
 
     if (sum_prob <= 0.0) {
         /* All nodes from the candidate set are tabu */
-        return choose_best_next(a, phase);
+        return neighbour_choose_closest_next(a, phase);
     } else {
         /* at least one neighbor is eligible, chose one according to the
            selection probabilities */
-        rnd = ran01( &instance->rnd_seed );
+        rnd = rng_uniform( &worker->rng );
         rnd *= sum_prob;
         DEBUG(assert ( rnd >= 0 && rnd <= sum_prob );)
         
-        i = 0;
-        partial_sum = prob_ptr[i];
-        /* This loop always stops because prob_ptr[nn_ants] == HUGE_VAL  */
-        while (partial_sum <= rnd) {
-            i++;
-            partial_sum += prob_ptr[i];
-        }
+        i = roulette_search(prob_ptr, nn_ants, rnd);
         /* This may very rarely happen because of rounding if rnd is
            close to 1.  */
         if (i == nn_ants) {
@@ -805,9 +1089,8 @@ int AntColony::neighbour_choose_and_move_to_next(AntStruct *a, int phase)
         }
         DEBUG( assert ( 0 <= i && i < nn_ants); );
         DEBUG( assert ( prob_ptr[i] > 0.0); );
-        help = nn_list[current_node][i];
+        help = nn_row[i];
         DEBUG(assert ( help >= 0 && help < num_node );)
-        DEBUG( assert ( a->visited[help] == FALSE ); )
         a->tour[phase] = help; /* nn_list[current_node][i]; */
         
         return help;
@@ -815,6 +1098,109 @@ int AntColony::neighbour_choose_and_move_to_next(AntStruct *a, int phase)
 }
 
 
+void AntColony::build_alias_table( int node, AntWorker *worker )
+/*    
+     FUNCTION:      build the Walker alias table of the candidate list of node
+                    (Vose's method), weights are the total_info of the arcs
+     INPUT:         node, the worker thread providing scratch buffers
+     OUTPUT:        none
+     (SIDE)EFFECT:  alias_prob/alias_index of node are rebuilt
+*/
+{
+    int k, s, l, n_small, n_large;
+    double sum = 0.0;
+    double *p = worker->prob_of_selection;    /* 缩放后的概率, 平均值为1 */
+    int *work = worker->candidate_mask;       /* 前端是 p<1 的格, 后端是 p>=1 的格 */
+    real_t *prob = alias_prob + node * nn_ants;
+    int *alias = alias_index + node * nn_ants;
+    
+    for (k = 0; k < nn_ants; k++) {
+        p[k] = total_info[arcs->nn_slot(node, k)];
+        sum += p[k];
+    }
+    if (sum <= 0.0) {
+        for (k = 0; k < nn_ants; k++) {
+            prob[k] = 1.0;
+            alias[k] = k;
+        }
+        return;
+    }
+    
+    n_small = 0;
+    n_large = 0;
+    for (k = 0; k < nn_ants; k++) {
+        p[k] = p[k] * nn_ants / sum;
+        if (p[k] < 1.0) {
+            work[n_small++] = k;
+        } else {
+            work[nn_ants - 1 - n_large++] = k;
+        }
+    }
+    while (n_small > 0 && n_large > 0) {
+        s = work[--n_small];
+        l = work[nn_ants - n_large--];
+        prob[s] = p[s];
+        alias[s] = l;
+        p[l] = (p[l] + p[s]) - 1.0;
+        if (p[l] < 1.0) {
+            work[n_small++] = l;
+        } else {
+            work[nn_ants - 1 - n_large++] = l;
+        }
+    }
+    /* 剩余的格概率为1(舍入误差) */
+    while (n_large > 0) {
+        l = work[nn_ants - n_large--];
+        prob[l] = 1.0;
+        alias[l] = l;
+    }
+    while (n_small > 0) {
+        s = work[--n_small];
+        prob[s] = 1.0;
+        alias[s] = s;
+    }
+}
+
+
+
+int AntColony::alias_choose_and_move_to_next(AntStruct *a, int phase, AntWorker *worker)
+/*    
+     FUNCTION:      Choose for an ant probabilistically a next node in the current
+                    node's candidate list by the alias table in O(1). Infeasible
+                    picks are rejected, which gives the same distribution as the
+                    roulette wheel over the feasible candidates.
+     INPUT:         pointer to ant the construction step "phase", the worker
+                    thread providing random stream
+     OUTPUT:        the chosen node
+     (SIDE)EFFECT:  ant moves to the chosen node; after config.alias_rejections
+                    rejections falls back to neighbour_choose_and_move_to_next
+*/
+{
+    int r, k, node;
+    int current_node = a->tour[phase-1];
+    int *nn_row = nn_list[current_node];
+    real_t *prob = alias_prob + current_node * nn_ants;
+    int *alias = alias_index + current_node * nn_ants;
+    double u;
+    
+    for (r = 0; r < config.alias_rejections; r++) {
+        /* 一个随机数同时决定格与格内的选择 */
+        u = rng_uniform(&worker->rng) * nn_ants;
+        k = MIN((int)u, nn_ants - 1);
+        if (u - k >= prob[k]) {
+            k = alias[k];
+        }
+        node = nn_row[k];
+        if (is_candidate(a, current_node, node)) {
+            a->tour[phase] = node;
+            return node;
+        }
+    }
+    return neighbour_choose_and_move_to_next(a, phase, worker);
+}
+
+
+
 /**************************************************************************
  **************************************************************************
 Procedures specific to the ant's tour manipulation other than construction
@@ -15,16 +15,30 @@
 #ifndef antColony_h
 #define antColony_h
 
-#define HEURISTIC(m,n)     (1.0 / ((double) distance[m][n] + 0.1))
-/* add a small constant to avoid division by zero if a distance is
- zero */
-
+#include <math.h>
 #include "problem.h"
 #include "localSearch.h"
+#include "threadPool.h"
 
 #define MAX_ANTS       1024    /* max no. of ants */
 #define MAX_NEIGHBOURS 512     /* max. no. of nearest neighbours in candidate set */
 
+class AntColony;
+
+/*
+ * 蚁群内部的工作线程. 每个线程拥有独立的选择概率数组、随机数流与local search,
+ * 线程之间只共享只读数据, 因此构造解/局部搜索时不需要同步
+ */
+struct AntWorker {
+    AntColony *colony;
+    int id;                        /* 线程编号, 负责 ants[id], ants[id + num_threads], ... */
+    double *prob_of_selection;     /* 依概率选择下一个node */
+    int *candidate_mask;           /* 近邻是否可行(-1可行, 0不可行), 见roulette_weights */
+    Rng rng;                       /* 线程私有的随机数流 */
+    LocalSearch *local_search;
+    int ls_skipped;                /* 本次迭代因 LS_POLICY_BUDGET 跳过的蚂蚁数 */
+};
+
 class AntColony {
 public:
     
@@ -35,32 +49,57 @@ public:
     AntStruct *ants;
     AntStruct *best_so_far_ant;
     
-    double **distance;
-    double   *prob_of_selection;
-    double   **pheromone;
-    double   **total_info;
+    DistanceMatrix distance;
+    ArcLayout *arcs;            /* layout of heuristic, pheromone and total_info */
+    real_t   *heuristic;
+    real_t   *pheromone;
+    real_t   *total_info;
+    real_t   *alias_prob;
+    int      *alias_index;
+    bool     alias_dirty;       /* total_info 改变后 alias table 需要重建 */
     int num_node;
     int n_ants;               /* number of ants */
     int nn_ants;              /* length of nearest neighbor lists for the ants'
                                     solution construction */
+    int nn_ext;               /* length of the extended nearest neighbor lists */
     int **nn_list;
+    int *demand;
+    int *demand_order;
     
     Point    *nodeptr;
     int vehicle_capacity;
+    double max_distance;
+    double service_time;
     
-    bool ls_flag;               /* indicates whether and which local search is used */
+    SolverConfig config;        /* 调节参数, 取自instance->config */
+    
+    int num_threads;            /* number of worker threads */
+    AntWorker *workers;         /* workers[0] runs in the calling thread */
+    ThreadPool *pool;           /* runs workers[1..num_threads-1], NULL if single threaded */
+    
+    /* local search 策略(config.ls_policy) */
+    int ls_capacity;            /* 以下数组的大小 */
+    int *ls_list;               /* 本次迭代做local search的蚂蚁, 按构造出的解的长度排列 */
+    double *ls_keys;            /* 排序用 */
+    int n_ls_list;
+    uint64_t *tour_hashes;      /* 前n_tour_hashes个: 上次迭代各蚂蚁构造出的解的hash, 升序 */
+    int n_tour_hashes;
+    double ls_start_time;       /* 本次迭代local search开始的时间, 用于统计 */
+    double ls_end_time;         /* LS_POLICY_BUDGET: coarse_clock() 到达该值后跳过其余的蚂蚁 */
     
     
     AntColony(Problem *instance);
     virtual ~AntColony();
+    void sync_instance(void);
     
     virtual void run_aco_iteration(void);
-    void init_aco();
-    void exit_aco();
+    virtual void init_aco();
+    virtual void exit_aco();
     
-    void construct_ant_solution(AntStruct *ant);
+    void construct_ant_solution(AntStruct *ant, AntWorker *worker);
     void construct_solutions( void );
     void do_local_search( void );
+    int select_local_search_ants( void );
     void ras_update( void );
     void pheromone_disturbance(void);
     void pheromone_trail_update( void );
@@ -74,19 +113,52 @@ public:
     void global_update_pheromone_weighted ( AntStruct *a, int weight );
     void compute_total_information( void );
     void compute_nn_list_total_information( void );
+    inline void update_total_information( int s );
     
     /* Ants' solution construction */
     void ant_empty_memory( AntStruct *a );
     void init_ant_place( AntStruct *a , int phase);
+    void visit_node( AntStruct *a, int node );
+    inline bool is_candidate( AntStruct *a, int current_node, int node );
     int choose_best_next( AntStruct *a, int phase );
     int neighbour_choose_best_next( AntStruct *a, int phase );
-    void choose_closest_next( AntStruct *a, int phase );
-    int neighbour_choose_and_move_to_next( AntStruct *a, int phase);
+    int choose_closest_next( AntStruct *a, int phase );
+    int neighbour_choose_closest_next( AntStruct *a, int phase );
+    int neighbour_choose_and_move_to_next( AntStruct *a, int phase, AntWorker *worker);
+    void build_alias_table( int node, AntWorker *worker );
+    int alias_choose_and_move_to_next( AntStruct *a, int phase, AntWorker *worker);
     
     /* Auxiliary procedures related to ants */
     int find_best ( void );
     int find_worst( void );
     static void copy_solution_from_to(AntStruct *a1, AntStruct *a2);
+    
+private:
+    void run_workers(void *(*handle)(void *));
 };
 
+/*
+ * 更新位于 s (见ArcLayout) 的弧的 total_info, alpha = 1 时不需要调用pow
+ */
+inline void AntColony::update_total_information( int s )
+{
+    alias_dirty = true;
+    if (config.alpha == 1.0) {
+        total_info[s] = pheromone[s] * heuristic[s];
+    } else {
+        total_info[s] = pow(pheromone[s], config.alpha) * heuristic[s];
+    }
+}
+
+/*
+ * 蚂蚁从current_node出发, node是否可以作为下一个配送点:
+ * 未访问, 且加入当前route后不超过车辆最大装载量与最大行驶距离
+ */
+inline bool AntColony::is_candidate( AntStruct *a, int current_node, int node )
+{
+    return a->unvisited_pos[node] < a->n_unvisited
+        && a->route_load + nodeptr[node].demand <= vehicle_capacity
+        && a->route_dist + (distance(current_node, node) + service_time) + distance(node, 0) <= max_distance;
+}
+
 #endif /* antColony_h */
@@ -28,7 +28,6 @@
 
 
 static bool report_flag = TRUE;   /* 结果是否输出文件 */
-static FILE *report, *best_so_far_report, *iter_report, *anneal_report;
 
 void write_params(Problem *instance);
 static void fprintf_parameters (FILE *stream, Problem *instance);
@@ -120,7 +119,7 @@ void print_probabilities(Problem *instance)
             if ( i == j )
                 p[j] = 0.;
             else
-                p[j] = instance->total_info[i][j];
+                p[j] = instance->arcs.value(instance->total_info, i, j);
             sum_prob += p[j];
         }
         for ( j = 0 ; j < num_node ; j++) {
@@ -152,9 +151,9 @@ void print_distance(Problem *instance)
     for ( i = 0 ; i < instance->num_node ; i++) {
         printf("From %d:  ",i);
         for ( j = 0 ; j < instance->num_node - 1 ; j++ ) {
-            printf(" %f", instance->distance[i][j]);
+            printf(" %f", instance->distance(i, j));
         }
-        printf(" %f\n", instance->distance[i][instance->num_node-1]);
+        printf(" %f\n", instance->distance(i, instance->num_node-1));
         printf("\n");
     }
     printf("\n");
@@ -173,8 +172,8 @@ void print_pheromone(Problem *instance)
     for ( i = 0 ; i < instance->num_node ; i++) {
         printf("From %d:  ",i);
         for ( j = 0 ; j < instance->num_node ; j++ ) {
-            printf(" %.10f ", instance->pheromone[i][j]);
-            if (instance->pheromone[i][j] > 1.0)
+            printf(" %.10f ", instance->arcs.value(instance->pheromone, i, j));
+            if (instance->arcs.value(instance->pheromone, i, j) > 1.0)
                 printf("XXXXX\n");
         }
         printf("\n");
@@ -190,17 +189,19 @@ void print_pheromone(Problem *instance)
 void print_total_info(Problem *instance)
 {
     int i, j, num_node =  instance->num_node;
-    double **total = instance->total_info;
+    double t;
     
     printf("combined pheromone and heuristic info\n\n");
     for (i=0; i < num_node; i++) {
         for (j = 0; j < num_node - 1 ; j++) {
-            printf(" %.15f &", total[i][j]);
-            if ( total[i][j] > 1.0 )
+            t = instance->arcs.value(instance->total_info, i, j);
+            printf(" %.15f &", t);
+            if ( t > 1.0 )
                 printf("XXXXX\n");
         }
-        printf(" %.15f\n", total[i][num_node-1]);
-        if ( total[i][num_node-1] > 1.0 )
+        t = instance->arcs.value(instance->total_info, i, num_node-1);
+        printf(" %.15f\n", t);
+        if ( t > 1.0 )
             printf("XXXXX\n");
     }
     printf("\n");
@@ -208,67 +209,92 @@ void print_total_info(Problem *instance)
 
 /*
  * 问题开始时
+ * 每个try写自己的report文件(文件名带try编号), 多个try可以并发运行
  */
 void init_report(Problem *instance, int ntry)
 {
     printf("\n############### start try %d ###############\n", ntry);
     
     char temp_buffer[LINE_BUF_LEN];
+    char time_buffer[26];
     
     if (report_flag) {
-        sprintf(temp_buffer,"../report/best.%s",instance->name);
-        report = fopen(temp_buffer, "w");
+        sprintf(temp_buffer,"../report/best.%s.%d",instance->name, ntry);
+        instance->report = fopen(temp_buffer, "w");
         
-        sprintf(temp_buffer,"../report/best_so_far.%s",instance->name);
-        best_so_far_report = fopen(temp_buffer, "a");
+        sprintf(temp_buffer,"../report/best_so_far.%s.%d",instance->name, ntry);
+        instance->best_so_far_report = fopen(temp_buffer, "a");
         
-        sprintf(temp_buffer,"../report/iter.%s",instance->name);
-        iter_report = fopen(temp_buffer, "w");
+        sprintf(temp_buffer,"../report/iter.%s.%d",instance->name, ntry);
+        instance->iter_report = fopen(temp_buffer, "w");
         
-        sprintf(temp_buffer,"../report/anneal.%s",instance->name);
-        anneal_report = fopen(temp_buffer, "w");
+        sprintf(temp_buffer,"../report/anneal.%s.%d",instance->name, ntry);
+        instance->anneal_report = fopen(temp_buffer, "w");
     } else {
-        report = NULL;
-        anneal_report = NULL;
-        best_so_far_report = NULL;
-        iter_report = NULL;
+        instance->report = NULL;
+        instance->anneal_report = NULL;
+        instance->best_so_far_report = NULL;
+        instance->iter_report = NULL;
     }
     
-    if (best_so_far_report) {
-        fprintf(best_so_far_report,"\n############### start try %d, time %s ###############\n", ntry, get_format_time());
+    if (instance->best_so_far_report) {
+        fprintf(instance->best_so_far_report,"\n############### start try %d, time %s ###############\n",
+                ntry, get_format_time(time_buffer));
     }
     write_params(instance);
 }
 
 /*
- * 问题结束时
+ * local search 策略的统计: 做了local search的蚂蚁数与耗时, 以及各策略跳过的蚂蚁数和
+ * 由此节省的时间(按每只蚂蚁的平均local search时间估计)
+ */
+static void fprintf_ls_statistics(FILE *stream, Problem *instance)
+{
+    double per_ant = instance->ls_ants > 0 ? instance->ls_time / instance->ls_ants : 0.0;
+    
+    fprintf(stream, "Local search: %d ants, %.2f s\t saved top-k: %d ants ~%.2f s\t changed: %d ants ~%.2f s\t budget: %d ants ~%.2f s\n",
+            instance->ls_ants, instance->ls_time,
+            instance->ls_skipped_top_k, instance->ls_skipped_top_k * per_ant,
+            instance->ls_skipped_changed, instance->ls_skipped_changed * per_ant,
+            instance->ls_skipped_budget, instance->ls_skipped_budget * per_ant);
+}
+
+/*
+ * 问题结束时, 关闭本try的report文件
  */
 void exit_report(Problem *instance, int ntry) {
+    char time_buffer[26];
     
     if(!check_solution(instance, instance->best_so_far_ant->tour, instance->best_so_far_ant->tour_size)) {
         exit(EXIT_FAILURE);
     }
     
     printf("\n\nBest Length: %f\t Iterations: %d\t At time %.2f\t Tot.time %.2f\n",
-            instance->best_so_far_ant->tour_length, instance->iteration, instance->best_so_far_time, elapsed_time(REAL));
+            instance->best_so_far_ant->tour_length, instance->iteration, instance->best_so_far_time, elapsed_run_time(instance));
+    if (instance->config.ls_flag) {
+        fprintf_ls_statistics(stdout, instance);
+    }
     printf("############### end try %d ###############\n\n", ntry);
     
-    if (report) {
-        fprintf(report, "Best Length: %f\t Iterations: %d\t At time %.2f\t Tot.time %.2f\n",
-                instance->best_so_far_ant->tour_length, instance->iteration, instance->best_so_far_time, elapsed_time(REAL));
-        fflush(report);
+    if (instance->report) {
+        fprintf(instance->report, "Best Length: %f\t Iterations: %d\t At time %.2f\t Tot.time %.2f\n",
+                instance->best_so_far_ant->tour_length, instance->iteration, instance->best_so_far_time, elapsed_run_time(instance));
+        if (instance->config.ls_flag) {
+            fprintf_ls_statistics(instance->report, instance);
+        }
+        fclose(instance->report);
     }
 
-    if (best_so_far_report){
-        print_solution_to_file(instance, best_so_far_report, instance->best_so_far_ant->tour, instance->best_so_far_ant->tour_size);
-        fprintf(best_so_far_report,"############### end try %d, time %s ###############\n\n",ntry, get_format_time());
-        fflush(best_so_far_report);
+    if (instance->best_so_far_report){
+        print_solution_to_file(instance, instance->best_so_far_report, instance->best_so_far_ant->tour, instance->best_so_far_ant->tour_size);
+        fprintf(instance->best_so_far_report,"############### end try %d, time %s ###############\n\n",ntry, get_format_time(time_buffer));
+        fclose(instance->best_so_far_report);
     }
-    if (iter_report) {
-        fflush(iter_report);
+    if (instance->iter_report) {
+        fclose(instance->iter_report);
     }
-    if (anneal_report) {
-        fflush(anneal_report);
+    if (instance->anneal_report) {
+        fclose(instance->anneal_report);
     }
 }
 
@@ -300,8 +326,8 @@ void write_best_so_far_report(Problem *instance)
 {
     printf("best so far length %f, iteration: %d, time %.2f\n",
            instance->best_so_far_ant->tour_length, instance->iteration, instance->best_so_far_time);
-    if (best_so_far_report) {
-        fprintf(best_so_far_report, "%f\t %d\t %.3f\n",
+    if (instance->best_so_far_report) {
+        fprintf(instance->best_so_far_report, "%f\t %d\t %.3f\n",
                 instance->best_so_far_ant->tour_length, instance->iteration, instance->best_so_far_time);
     }
 }
@@ -315,10 +341,10 @@ void write_best_so_far_report(Problem *instance)
 void write_iter_report(Problem *instance)
 {
     DEBUG(printf("iteration: %ld, iter best length %f, time %.2f\n",
-           instance->iteration, instance->iteration_best_ant->tour_length, elapsed_time( REAL));)
-    if (iter_report) {
-        fprintf(iter_report, "%f\t %d\t %.3f\n",
-                instance->iteration_best_ant->tour_length, instance->iteration, elapsed_time( REAL));
+           instance->iteration, instance->iteration_best_ant->tour_length, elapsed_run_time(instance));)
+    if (instance->iter_report) {
+        fprintf(instance->iter_report, "%f\t %d\t %.3f\n",
+                instance->iteration_best_ant->tour_length, instance->iteration, elapsed_run_time(instance));
     }
 }
 
@@ -327,30 +353,32 @@ void write_iter_report(Problem *instance)
  */
 void write_anneal_report(Problem *instance, AntStruct *ant, Move *move)
 {
-    if (InversionMove *p = dynamic_cast<InversionMove *>(move)) {
+    Move *p = move;
+    
+    if (move->type == INVERSION_MOVE) {
         DEBUG(printf("[Inversion Move] moved length %f, gain:%f, pos_n1:%ld, pos_n2:%ld, time %.2f\n",
-               ant->tour_length, p->gain, p->pos_n1, p->pos_n2, elapsed_time( REAL));)
-        if (anneal_report) {
-            fprintf(anneal_report, "[Inversion Move]: best length %f, gain:%f, pos_n1:%d, pos_n2:%d, time %.2f\n",
-                    ant->tour_length, p->gain, p->pos_n1, p->pos_n2, elapsed_time( REAL));
+               ant->tour_length, p->gain, p->pos_n1, p->pos_n2, elapsed_run_time(instance));)
+        if (instance->anneal_report) {
+            fprintf(instance->anneal_report, "[Inversion Move]: best length %f, gain:%f, pos_n1:%d, pos_n2:%d, time %.2f\n",
+                    ant->tour_length, p->gain, p->pos_n1, p->pos_n2, elapsed_run_time(instance));
         }
-    } else if (InsertionMove *p = dynamic_cast<InsertionMove *>(move)) {
+    } else if (move->type == INSERTION_MOVE) {
         DEBUG(printf("[Insertion Move] moved length %f, gain:%f, pos_n1:%ld, pos_n2:%ld, load_r1:%ld, load_r2:%ld, time %.2f\n",
-               ant->tour_length, p->gain, p->pos_n1, p->pos_n2, p->load_r1, p->load_r2, elapsed_time( REAL));)
-        if (anneal_report) {
-            fprintf(anneal_report, "[Insertion Move]: best length %f, gain:%f, pos_n1:%d, pos_n2:%d, time %.2f\n",
-                    ant->tour_length, p->gain, p->pos_n1, p->pos_n2, elapsed_time( REAL));
+               ant->tour_length, p->gain, p->pos_n1, p->pos_n2, p->load_r1, p->load_r2, elapsed_run_time(instance));)
+        if (instance->anneal_report) {
+            fprintf(instance->anneal_report, "[Insertion Move]: best length %f, gain:%f, pos_n1:%d, pos_n2:%d, time %.2f\n",
+                    ant->tour_length, p->gain, p->pos_n1, p->pos_n2, elapsed_run_time(instance));
         }
-    } else if (ExchangeMove *p = dynamic_cast<ExchangeMove *>(move)) {
+    } else if (move->type == EXCHANGE_MOVE) {
         DEBUG(printf("[Exchange Move] moved length %f, gain:%f, pos_n1:%ld, pos_n2:%ld, load_r1:%ld, load_r2:%ld, time %.2f\n",
-               ant->tour_length, p->gain, p->pos_n1, p->pos_n2, p->load_r1, p->load_r2, elapsed_time( REAL));)
-        if (anneal_report) {
-            fprintf(anneal_report, "[Exchange Move] moved length %f, gain:%f, pos_n1:%d, pos_n2:%d, load_r1:%d, load_r2:%d, time %.2f\n",
-                    ant->tour_length, p->gain, p->pos_n1, p->pos_n2, p->load_r1, p->load_r2, elapsed_time( REAL));
+               ant->tour_length, p->gain, p->pos_n1, p->pos_n2, p->load_r1, p->load_r2, elapsed_run_time(instance));)
+        if (instance->anneal_report) {
+            fprintf(instance->anneal_report, "[Exchange Move] moved length %f, gain:%f, pos_n1:%d, pos_n2:%d, load_r1:%d, load_r2:%d, time %.2f\n",
+                    ant->tour_length, p->gain, p->pos_n1, p->pos_n2, p->load_r1, p->load_r2, elapsed_run_time(instance));
         }
     }
 //    print_solution(instance, ant->tour, ant->tour_size);
-    print_solution_to_file(instance, anneal_report, ant->tour, ant->tour_size);
+    print_solution_to_file(instance, instance->anneal_report, ant->tour, ant->tour_size);
     
 }
 
@@ -366,27 +394,40 @@ void write_params(Problem *instance)
     fprintf_parameters (stdout, instance);
     fprintf(stdout, "\n");
     
-    if (report) {
-        fprintf(report,"\nParameter-settings: \n\n");
-        fprintf_parameters (report, instance);
-        fprintf(report,"\n");
+    if (instance->report) {
+        fprintf(instance->report,"\nParameter-settings: \n\n");
+        fprintf_parameters (instance->report, instance);
+        fprintf(instance->report,"\n");
     }
 }
 
 static void fprintf_parameters (FILE *stream, Problem *instance)
 {
-    fprintf(stream,"max_time\t\t %.2f\n", instance->max_runtime);
+    fprintf(stream,"max_time\t\t %.2f\n", instance->config.max_runtime);
     fprintf(stream,"seed\t\t %d\n", instance->rnd_seed);
     fprintf(stream,"optimum\t\t\t %f\n", instance->optimum);
     fprintf(stream,"n_ants\t\t\t %d\n", instance->n_ants);
     fprintf(stream,"nn_ants\t\t\t %d\n", instance->nn_ants);
-    fprintf(stream,"alpha\t\t\t %.2f\n", alpha);
-    fprintf(stream,"beta\t\t\t %.2f\n", beta);
-    fprintf(stream,"rho\t\t\t %.2f\n", rho);
-    fprintf(stream,"ras_ranks\t\t %d\n", ras_ranks);
-    fprintf(stream,"ls_flag\t\t\t %d\n", instance->ls_flag);
+    fprintf(stream,"nn_ext\t\t\t %d\n", instance->nn_ext);
+    fprintf(stream,"alpha\t\t\t %.2f\n", instance->config.alpha);
+    fprintf(stream,"beta\t\t\t %.2f\n", instance->config.beta);
+    fprintf(stream,"rho\t\t\t %.2f\n", instance->config.rho);
+    fprintf(stream,"ras_ranks\t\t %d\n", instance->config.ras_ranks);
+    fprintf(stream,"ls_flag\t\t\t %d\n", instance->config.ls_flag);
     fprintf(stream,"nn_ls\t\t\t %d\n", instance->nn_ls);
-    fprintf(stream,"dlb_flag\t\t %d\n", instance->dlb_flag);
+    fprintf(stream,"dlb_flag\t\t %d\n", instance->config.dlb_flag);
+    fprintf(stream,"tabu_tenure\t\t %d\n", instance->config.tabu_tenure);
+    fprintf(stream,"sa_replicas\t\t %d\n", instance->config.sa_replicas);
+    fprintf(stream,"sa_ladder_ratio\t\t %.2f\n", instance->config.sa_ladder_ratio);
+    fprintf(stream,"sa_batch_size\t\t %d\n", instance->config.sa_batch_size);
+    fprintf(stream,"or_opt_flag\t\t %d\n", instance->config.or_opt_flag);
+    fprintf(stream,"or3_opt_flag\t\t %d\n", instance->config.or3_opt_flag);
+    fprintf(stream,"inter_ls_flag\t\t %d\n", instance->config.inter_ls_flag);
+    fprintf(stream,"ls_policy\t\t %d\n", instance->config.ls_policy);
+    fprintf(stream,"ls_top_k\t\t %d\n", instance->config.ls_top_k);
+    fprintf(stream,"ls_time_budget\t\t %.2f\n", instance->config.ls_time_budget);
+    fprintf(stream,"sparse_threshold\t %d\n", instance->config.sparse_threshold);
+    fprintf(stream,"num_threads\t\t %d\n", instance->num_threads);
 }
 
 /*
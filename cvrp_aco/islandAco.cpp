@@ -0,0 +1,160 @@
+/*********************************
+
+ Ant Colony Optimization algorithms (AS, ACS, EAS, RAS, MMAS) for CVRP
+
+ Created by 孙晓奇 on 2016/10/8.
+ Copyright © 2016年 xiaoqi.sxq. All rights reserved.
+
+ Program's name: acovrp
+ Purpose: Island model, several independent colonies exchange their best solutions.
+
+ email: sunxq1991@gmail.com
+
+ *********************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+
+#include "islandAco.h"
+#include "vrpHelper.h"
+#include "utilities.h"
+#include "io.h"
+#include "timer.h"
+
+static void *island_handle(void *in);
+
+IslandAco::~IslandAco()
+{
+    delete island_pool;
+    for (int i = 1; i < (int)islands.size(); i++) {
+        delete island_solvers[i];
+        exit_problem(islands[i]);
+    }
+}
+
+/*
+ * 创建其余的岛并初始化各岛的信息素
+ */
+void IslandAco::init_aco()
+{
+    Problem *island;
+    AntColony *solver;
+
+    AntColony::init_aco();
+
+    islands.push_back(instance);
+    island_solvers.push_back(this);
+    for (int i = 1; i < instance->num_islands; i++) {
+        island = new Problem(-i);
+        init_island_problem(instance, island);
+        solver = new AntColony(island);
+        solver->init_aco();
+        islands.push_back(island);
+        island_solvers.push_back(solver);
+    }
+
+    if (islands.size() > 1) {
+        island_pool = new ThreadPool(islands.size() - 1);
+    }
+}
+
+void IslandAco::exit_aco()
+{
+    delete island_pool;
+    island_pool = NULL;
+
+    AntColony::exit_aco();
+}
+
+/*
+ * 各岛独立迭代 migration_interval 次之后交换最优解.
+ * 主问题的迭代次数由调用者(main)在每次外循环后加1, 因此这里只计入前 migration_interval-1 次
+ */
+void IslandAco::run_aco_iteration()
+{
+    int i;
+
+    for (i = 1; i < (int)islands.size(); i++) {
+        island_pool->submit(island_handle, (void *)island_solvers[i]);
+    }
+
+    for (i = 0; i < instance->config.migration_interval; i++) {
+        if (deadline_expired(instance->deadline)) {
+            break;
+        }
+        if (i > 0) {
+            instance->iteration++;
+        }
+        this->AntColony::run_aco_iteration();
+    }
+
+    if (island_pool != NULL) {
+        island_pool->wait();
+    }
+
+    migrate();
+}
+
+/*
+ * 交换最优解: 每个岛接收其它岛中最好的解, 在其上释放信息素;
+ * 若该解优于本岛最优解, 则作为本岛的 best_so_far_ant
+ */
+void IslandAco::migrate(void)
+{
+    int i, k, best = 0, second = -1;
+    AntStruct *migrant;
+    Problem *island;
+
+    if (islands.size() < 2) {
+        return;
+    }
+
+    /* 最好与次好的岛, 最好的岛接收次好的解 */
+    for (i = 1; i < (int)islands.size(); i++) {
+        if (islands[i]->best_so_far_ant->tour_length < islands[best]->best_so_far_ant->tour_length) {
+            second = best;
+            best = i;
+        } else if (second < 0 || islands[i]->best_so_far_ant->tour_length < islands[second]->best_so_far_ant->tour_length) {
+            second = i;
+        }
+    }
+
+    for (k = 0; k < (int)islands.size(); k++) {
+        island = islands[k];
+        migrant = islands[k == best ? second : best]->best_so_far_ant;
+
+        island_solvers[k]->global_update_pheromone(migrant);
+
+        if (migrant->tour_length - island->best_so_far_ant->tour_length < -EPSILON) {
+            copy_solution_from_to(migrant, island->best_so_far_ant);
+            island->best_so_far_time = elapsed_run_time(island);
+            island->best_solution_iter = island->iteration;
+            island->best_stagnate_cnt = 0;
+            if (island->pid == 0) {
+                write_best_so_far_report(island);
+            }
+        }
+    }
+
+    TRACE(printf("migration: best island %d length %f\n", islands[best]->pid, islands[best]->best_so_far_ant->tour_length);)
+}
+
+/*
+ * 线程函数: 岛独立迭代 migration_interval 次
+ */
+static void *island_handle(void *in)
+{
+    AntColony *solver = (AntColony *)in;
+    Problem *island = solver->instance;
+
+    for (int i = 0; i < island->config.migration_interval; i++) {
+        if (deadline_expired(island->deadline)) {
+            break;
+        }
+        solver->run_aco_iteration();
+        island->iteration++;
+    }
+    return NULL;
+}
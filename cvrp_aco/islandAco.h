@@ -0,0 +1,49 @@
+/*********************************
+
+ Ant Colony Optimization algorithms (AS, ACS, EAS, RAS, MMAS) for CVRP
+
+ Created by 孙晓奇 on 2016/10/8.
+ Copyright © 2016年 xiaoqi.sxq. All rights reserved.
+
+ Program's name: acovrp
+ Purpose: Island model, several independent colonies exchange their best solutions.
+
+ email: sunxq1991@gmail.com
+
+ *********************************/
+
+#ifndef islandAco_h
+#define islandAco_h
+
+#include <stdio.h>
+#include <vector>
+#include "problem.h"
+#include "antColony.h"
+#include "threadPool.h"
+
+using namespace std;
+
+/*
+ * 主问题本身是第0个岛, 在调用线程中求解; 其余 num_islands-1 个岛各自拥有独立的
+ * Problem(信息素、蚂蚁、随机数种子), 在线程池中求解.
+ * 每次外循环各岛独立迭代 migration_interval 次, 然后交换最优解(migration).
+ * 主问题的 num_threads 应为1, 所有核都用于岛.
+ */
+class IslandAco: public AntColony {
+public:
+    IslandAco(Problem *inst):AntColony(inst), island_pool(NULL){}
+    virtual ~IslandAco();
+
+    virtual void init_aco(void);
+    virtual void exit_aco(void);
+    virtual void run_aco_iteration(void);
+
+private:
+    vector<Problem *> islands;          /* islands[0] 即主问题 */
+    vector<AntColony *> island_solvers; /* islands[0] 对应 this */
+    ThreadPool *island_pool;
+
+    void migrate(void);
+};
+
+#endif /* islandAco_h */
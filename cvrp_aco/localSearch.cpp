@@ -23,17 +23,105 @@
 #include "vrpHelper.h"
 #include "io.h"
 
+#define MAX_SEGMENT 3       /* cross-exchange 中交换的最大段长 */
+
 LocalSearch::LocalSearch(Problem *instance) {
     this->instance = instance;
-    
+    this->rng = &instance->rng;
+    buffer_size = 0;
+    dlb = NULL;
+    route_node_map = NULL;
+    tour_node_pos = NULL;
+    next_node = NULL;
+    prev_node = NULL;
+    route_of = NULL;
+    prefix_load = NULL;
+    prefix_count = NULL;
+    prefix_dist = NULL;
+    route_load = NULL;
+    route_count = NULL;
+    route_dist = NULL;
+    route_stamp = NULL;
+    node_stamp = NULL;
+    ls_order = NULL;
+    seq_a = NULL;
+    seq_b = NULL;
+    sync_instance();
+}
+
+LocalSearch::~LocalSearch() {
+    free_buffers();
+}
+
+void LocalSearch::free_buffers(void) {
+    free(dlb);
+    free(route_node_map);
+    free(tour_node_pos);
+    free(next_node);
+    free(prev_node);
+    free(route_of);
+    free(prefix_load);
+    free(prefix_count);
+    free(prefix_dist);
+    free(route_load);
+    free(route_count);
+    free(route_dist);
+    free(route_stamp);
+    free(node_stamp);
+    free(ls_order);
+    free(seq_a);
+    free(seq_b);
+}
+
+/*
+ FUNCTION:       (re)load the data of the instance
+ INPUT:          none
+ OUTPUT:         none
+ (SIDE)EFFECTS:  the scratch buffers are reallocated if num_node has grown
+ */
+void LocalSearch::sync_instance(void) {
     ants = instance->ants;
     n_ants = instance->n_ants;
-    ls_flag = instance->ls_flag;
+    ls_flag = instance->config.ls_flag;
     num_node = instance->num_node;
     nn_list = instance->nn_list;
     nn_ls = instance->nn_ls;
-    dlb_flag = instance->dlb_flag;
+    dlb_flag = instance->config.dlb_flag;
+    or_opt_flag = instance->config.or_opt_flag;
+    or3_opt_flag = instance->config.or3_opt_flag;
+    inter_ls_flag = instance->config.inter_ls_flag;
     distance = instance->distance;
+    demand = instance->demand;
+    vehicle_capacity = instance->vehicle_capacity;
+    max_distance = instance->max_distance;
+    service_time = instance->service_time;
+    
+    if (num_node > buffer_size) {
+        free_buffers();
+        buffer_size = num_node;
+        dlb = (bool *)malloc(buffer_size * sizeof(bool));
+        route_node_map = (bool *)malloc(buffer_size * sizeof(bool));
+        tour_node_pos = (int *)malloc(buffer_size * sizeof(int));
+        /* 点与哨兵(最多buffer_size条route) */
+        next_node = (int *)malloc(2 * buffer_size * sizeof(int));
+        prev_node = (int *)malloc(2 * buffer_size * sizeof(int));
+        route_of = (int *)malloc(2 * buffer_size * sizeof(int));
+        prefix_load = (int *)malloc(2 * buffer_size * sizeof(int));
+        prefix_count = (int *)malloc(2 * buffer_size * sizeof(int));
+        prefix_dist = (double *)malloc(2 * buffer_size * sizeof(double));
+        route_load = (int *)malloc(buffer_size * sizeof(int));
+        route_count = (int *)malloc(buffer_size * sizeof(int));
+        route_dist = (double *)malloc(buffer_size * sizeof(double));
+        route_stamp = (int *)malloc(buffer_size * sizeof(int));
+        node_stamp = (int *)malloc(buffer_size * sizeof(int));
+        ls_order = (int *)malloc(buffer_size * sizeof(int));
+        seq_a = (int *)malloc(buffer_size * sizeof(int));
+        seq_b = (int *)malloc(buffer_size * sizeof(int));
+        for (int i = 0; i < buffer_size; i++) {
+            dlb[i] = FALSE;
+            route_node_map[i] = FALSE;
+        }
+    }
 }
 
 /*
@@ -62,13 +150,7 @@ void LocalSearch::do_local_search(void)
 //        }
         
         if (ls_flag) {
-             // 1) 2-opt local search
-            two_opt_solution(ants[k].tour, ants[k].tour_size);
-            
-            //2) swap - exchange 2 nodes in the tour
-//            swap(ants[k].tour, ants[k].tour_size);
-            
-            ants[k].tour_length = compute_tour_length(instance, ants[k].tour, ants[k].tour_size);
+            do_local_search(&ants[k]);
         }
         
         //debug
@@ -79,10 +161,15 @@ void LocalSearch::do_local_search(void)
 
 /*
  * apply loacal search to a single ant
+ * 1) inter-route: relocate, swap, 2-opt*, cross-exchange (可能减少route数)
+ * 2) intra-route: 2-opt, Or-opt
  */
 void LocalSearch::do_local_search(AntStruct *ant)
 {
-    two_opt_solution(ant->tour, ant->tour_size);
+    if (inter_ls_flag) {
+        ant->tour_size = inter_route_solution(ant->tour, ant->tour_size);
+    }
+    intra_route_solution(ant->tour, ant->tour_size);
     ant->tour_length = compute_tour_length(instance, ant->tour, ant->tour_size);
 }
 
@@ -107,7 +194,7 @@ int * LocalSearch::generate_random_permutation( int n )
 
    for ( i = 0 ; i < n ; i++ ) {
      /* find (randomly) an index for a free unit */ 
-     rnd  = ran01 ( &instance->rnd_seed );
+     rnd  = rng_uniform ( rng );
      node = (int) (rnd  * (n - tot_assigned)); 
      assert( i + node < n );
      help = r[i];
@@ -119,30 +206,17 @@ int * LocalSearch::generate_random_permutation( int n )
 }
 
 /*
- FUNCTION:       2-opt all routes of an ant's solution.
+ FUNCTION:       2-opt (and Or-opt if or_opt_flag) all routes of an ant's solution.
  INPUT:          tour, an ant's solution
                  depotId
  OUTPUT:         none
+ COMMENTS:       dlb/route_node_map are all FALSE on entry and on exit, only the
+                 entries of the nodes in tour are touched, so the cost is O(tour_size)
  */
-void LocalSearch::two_opt_solution(int *tour, int tour_size)
+void LocalSearch::intra_route_solution(int *tour, int tour_size)
 {
-    bool *dlb;               /* vector containing don't look bits */
-    bool *route_node_map;    /* mark for all nodes in a single route */
-    int *tour_node_pos;     /* positions of nodes in tour */
-
     int route_beg = 0;
     
-    dlb = (bool *)malloc(num_node * sizeof(bool));
-    for (int i = 0 ; i < num_node; i++) {
-        dlb[i] = FALSE;
-    }
-    
-    route_node_map =  (bool *)malloc(num_node * sizeof(bool));
-    for (int j = 0; j < num_node; j++) {
-        route_node_map[j] = FALSE;
-    }
-    
-    tour_node_pos =  (int *)malloc(num_node * sizeof(int));
     for (int j = 0; j < tour_size; j++) {
         tour_node_pos[tour[j]] = j;
     }
@@ -153,8 +227,23 @@ void LocalSearch::two_opt_solution(int *tour, int tour_size)
             tour_node_pos[0] = route_beg;
             two_opt_single_route(tour, route_beg, i-1, dlb, route_node_map, tour_node_pos);
             
-            for (int j = 0; j < num_node; j++) {
-                route_node_map[j] = FALSE;
+            /* 2-opt 与 Or-opt 交替进行, 直到 Or-opt 也不能改进; 每次之前清除本route的 don't look bits */
+            while (or_opt_flag) {
+                for (int j = route_beg; j < i; j++) {
+                    dlb[tour[j]] = FALSE;
+                }
+                if (or_opt_single_route(tour, route_beg, i-1, dlb, route_node_map, tour_node_pos) == 0) {
+                    break;
+                }
+                for (int j = route_beg; j < i; j++) {
+                    dlb[tour[j]] = FALSE;
+                }
+                two_opt_single_route(tour, route_beg, i-1, dlb, route_node_map, tour_node_pos);
+            }
+            
+            /* route_node_map 在各route间复用, 只需清除本route的点, 不必清除整个数组 */
+            for (int j = route_beg; j < i; j++) {
+                route_node_map[tour[j]] = FALSE;
             }
             route_beg = i;
             
@@ -163,9 +252,9 @@ void LocalSearch::two_opt_solution(int *tour, int tour_size)
         }
     }
     
-    free( dlb );
-    free(route_node_map);
-    free(tour_node_pos);
+    for (int j = 0; j < tour_size; j++) {
+        dlb[tour[j]] = FALSE;
+    }
 }
 
 /*
@@ -215,7 +304,7 @@ void LocalSearch::two_opt_single_route(int *tour, int rbeg, int rend,
                 continue;
             
             s_n1 = pos_n1 == rend ? tour[rbeg] : tour[pos_n1+1];
-            radius = distance[n1][s_n1];
+            radius = distance(n1, s_n1);
             /* First search for n1's nearest neighbours, use successor of n1 */
             for ( h = 0 ; h < nn_ls ; h++ ) {
                 n2 = nn_list[n1][h]; /* exchange partner, determine its position */
@@ -223,11 +312,11 @@ void LocalSearch::two_opt_single_route(int *tour, int rbeg, int rend,
                     /* 该点不在本route中 */
                     continue;
                 }
-                if (radius - distance[n1][n2] > EPSILON) {
+                if (radius - distance(n1, n2) > EPSILON) {
                     pos_n2 = tour_node_pos[n2];
                     s_n2 = pos_n2 == rend ? tour[rbeg] : tour[pos_n2+1];
-                    gain =  - radius + distance[n1][n2] +
-                            distance[s_n1][s_n2] - distance[n2][s_n2];
+                    gain =  - radius + distance(n1, n2) +
+                            distance(s_n1, s_n2) - distance(n2, s_n2);
                     if ( gain < -EPSILON ) {
                         h1 = n1; h2 = s_n1; h3 = n2; h4 = s_n2;
                         goto exchange2opt;
@@ -238,21 +327,21 @@ void LocalSearch::two_opt_single_route(int *tour, int rbeg, int rend,
             
             /* Search one for next n1's h-nearest neighbours, use predecessor n1 */
             p_n1 = pos_n1 == rbeg ? tour[rend] : tour[pos_n1-1];
-            radius = distance[p_n1][n1];
+            radius = distance(p_n1, n1);
             for ( h = 0 ; h < nn_ls ; h++ ) {
                 n2 = nn_list[n1][h];  /* exchange partner, determine its position */
                 if (route_node_map[n2] == FALSE) {
                     /* 该点不在本route中 */
                     continue;
                 }
-                if ( radius - distance[n1][n2] > EPSILON) {
+                if ( radius - distance(n1, n2) > EPSILON) {
                     pos_n2 = tour_node_pos[n2];
                     p_n2 = pos_n2 == rbeg ? tour[rend] : tour[pos_n2-1];
                     
                     if ( p_n2 == n1 || p_n1 == n2)
                         continue;
-                    gain =  - radius + distance[n1][n2] +
-                            distance[p_n1][p_n2] - distance[p_n2][n2];
+                    gain =  - radius + distance(n1, n2) +
+                            distance(p_n1, p_n2) - distance(p_n2, n2);
                     if ( gain < -EPSILON ) {
                         h1 = p_n1; h2 = n1; h3 = p_n2; h4 = n2;
                         goto exchange2opt;
@@ -298,117 +387,411 @@ exchange2opt:
 
 
 /*
- * The swap operation selects two customers at random and 
- * then swaps these two customers in their positions.
+ FUNCTION:       Or-opt a single route: move a segment of 1..3 nodes to another
+                 position of the route. If or3_opt_flag, the segment may also be
+                 inserted reversed (Or-3opt).
+ INPUT:          rbeg, route的起始位置(depot)
+                 rend, route的结束位置(包含rend处的点, rend处不为0)
+ OUTPUT:         number of exchanges
+ COMMENTS:       a segment starts or ends at n1 and is inserted next to one of
+                 n1's nearest neighbours n2; the search for n2 stops when
+                 distance(n1, n2) is not smaller than the removal gain of the
+                 segment (radius). Don't look bits as in 2-opt.
  */
-void LocalSearch::swap(int *tour, int tour_size)
+int LocalSearch::or_opt_single_route(int *tour, int rbeg, int rend,
+                          bool *dlb, bool *route_node_map, int *tour_node_pos)
 {
-    /* array of single route load */
-    int *route_load = new int[num_node-1];
-    /* array of single route distance */
-    double *route_dist = new double[num_node-1];
-    int beg;
-    int load = 0, load1 = 0, load2 = 0;
-    double dist = 0, dist1 = 0, dist2 = 0;
+    int n1, n2;                            /* n1: 段的一端, n2: n1的近邻 */
+    int f, e, p, s;                        /* 段的首尾点, 段的前驱和后继 */
+    int x, y;                              /* 插入位置的前后两点 */
+    int pos_n1, pos_n2, seg_beg, seg_end;  /* positions */
+    int num_route_node = rend - rbeg + 1;  /* number of nodes in a single route(depot只计一次) */
+    int seg[3];
     
-    Point *nodes = instance->nodeptr;
+    int i, k, h, l, len, side, q;
+    int improvement_flag, n_exchanges = 0;
+    bool reverse;
+    double radius;             /* 移走该段的收益, radius of nn-search */
+    double gain;
     
-    int i = 0, j = 0, k = 0;
-    double gain = 0;
-    int n1, p_n1, s_n1, n2, p_n2, s_n2;
-    int p1 = 0, p2 = 0;     /* path idx of node n1 and n2 */
+    DEBUG(assert(tour[rbeg] == 0 && tour[rend+1] == 0);)
     
+    improvement_flag = TRUE;
     
-    // 1) step 1: 获取load/distance array
-    load = 0;
-    dist = 0;
-    k = 0;
-    beg = 0;
-    for (i = 1; i < tour_size; i++) {
-        load += nodes[tour[i]].demand;
-        dist += distance[tour[i-1]][tour[i]];
+    while ( improvement_flag ) {
+        
+        improvement_flag = FALSE;
         
+        for (l = 1 ; l < num_route_node; l++) {
+            
+            pos_n1 = rbeg + l;
+            n1 = tour[pos_n1];
+            if (dlb_flag && dlb[n1])
+                continue;
+            
+            /* side 0: 段从n1开始向后; side 1: 段从n1开始向前 */
+            for (side = 0; side < 2; side++) {
+                for (len = side + 1; len <= 3; len++) {
+                    seg_beg = side == 0 ? pos_n1 : pos_n1 - len + 1;
+                    seg_end = seg_beg + len - 1;
+                    if (seg_beg <= rbeg || seg_end > rend) {
+                        break;
+                    }
+                    f = tour[seg_beg]; e = tour[seg_end];
+                    p = tour[seg_beg-1]; s = tour[seg_end+1];
+                    radius = distance(p, f) + distance(e, s) - distance(p, s);
+                    
+                    for ( h = 0 ; h < nn_ls ; h++ ) {
+                        n2 = nn_list[n1][h];
+                        if (route_node_map[n2] == FALSE) {
+                            /* 该点不在本route中 */
+                            continue;
+                        }
+                        if (radius - distance(n1, n2) <= EPSILON) {
+                            break;
+                        }
+                        pos_n2 = tour_node_pos[n2];
+                        if (pos_n2 >= seg_beg && pos_n2 <= seg_end) {
+                            continue;
+                        }
+                        /* 插入到 n2 之后(q = pos_n2) 或之前(q = pos_n2 - 1), n1 与 n2 相邻 */
+                        for (k = 0; k < 2; k++) {
+                            q = k == 0 ? pos_n2 : pos_n2 - 1;
+                            if (q >= seg_beg - 1 && q <= seg_end) {
+                                continue;
+                            }
+                            reverse = len > 1 && (k == 0) != (n1 == f);
+                            if (reverse && !or3_opt_flag) {
+                                continue;
+                            }
+                            x = tour[q]; y = tour[q+1];
+                            gain = - radius - distance(x, y);
+                            gain += reverse ? distance(x, e) + distance(f, y) : distance(x, f) + distance(e, y);
+                            if (gain < -EPSILON) {
+                                goto exchange_or_opt;
+                            }
+                        }
+                    }
+                }
+            }
+            /* No exchange */
+            dlb[n1] = TRUE;
+            continue;
+            
+exchange_or_opt:
+            n_exchanges++;
+            improvement_flag = TRUE;
+            dlb[p] = FALSE; dlb[s] = FALSE;
+            dlb[f] = FALSE; dlb[e] = FALSE;
+            dlb[x] = FALSE; dlb[y] = FALSE;
+            /* Now perform move */
+            for (i = 0; i < len; i++) {
+                seg[i] = tour[reverse ? seg_end - i : seg_beg + i];
+            }
+            if (q > seg_end) {
+                for (i = seg_end + 1; i <= q; i++) {
+                    tour[i - len] = tour[i];
+                    tour_node_pos[tour[i]] = i - len;
+                }
+                q -= len;
+            } else {
+                for (i = seg_beg - 1; i > q; i--) {
+                    tour[i + len] = tour[i];
+                    tour_node_pos[tour[i]] = i + len;
+                }
+            }
+            for (i = 0; i < len; i++) {
+                tour[q + 1 + i] = seg[i];
+                tour_node_pos[seg[i]] = q + 1 + i;
+            }
+        }
+    }
+    return n_exchanges;
+}
+
+/*
+ FUNCTION:       inter-route local search of an ant's solution: relocate, swap,
+                 2-opt* and cross-exchange of segments (at most MAX_SEGMENT nodes)
+ INPUT:          tour, an ant's solution, tour_size
+ OUTPUT:         new tour_size (empty routes are removed)
+ (SIDE)EFFECTS:  tour is improved until no improving move is found
+ COMMENTS:       granular neighbourhood: a move is only tried if it makes node u
+                 adjacent to one of its nn_ls nearest neighbours v in another
+                 route; first improvement. A pair (u, v) is skipped if neither
+                 route changed since u was last searched without improvement
+ */
+int LocalSearch::inter_route_solution(int *tour, int tour_size)
+{
+    int i, h, u, v, n_order;
+    bool improvement_flag = TRUE;
+    
+    load_routes(tour, tour_size);
+    
+    num_moves = 0;
+    for (i = 0; i < num_route; i++) {
+        route_stamp[i] = 0;
+    }
+    n_order = 0;
+    for (i = 1; i < tour_size; i++) {
+        if (tour[i] != 0) {
+            ls_order[n_order++] = tour[i];
+            node_stamp[tour[i]] = -1;
+        }
+    }
+    
+    while (improvement_flag) {
+        improvement_flag = FALSE;
+        for (i = 0; i < n_order; i++) {
+            u = ls_order[i];
+            for (h = 0; h < nn_ls; h++) {
+                v = nn_list[u][h];
+                if (route_of[v] == route_of[u]) {
+                    continue;
+                }
+                if (route_stamp[route_of[u]] < node_stamp[u] && route_stamp[route_of[v]] < node_stamp[u]) {
+                    continue;
+                }
+                if (try_cross_exchange(u, v) || try_cross_exchange(v, u)
+                    || try_two_opt_star(u, v) || try_two_opt_star(v, u)) {
+                    improvement_flag = TRUE;
+                    break;
+                }
+            }
+            if (h == nn_ls) {
+                node_stamp[u] = num_moves + 1;
+            }
+        }
+    }
+    
+    return store_routes(tour);
+}
+
+/*
+ * 将 tour 转为链表表示, 计算各route的缓存; 空route被忽略
+ */
+void LocalSearch::load_routes(int *tour, int tour_size)
+{
+    int i, beg = 0;
+    
+    num_route = 0;
+    for (i = 1; i < tour_size; i++) {
         if (tour[i] == 0) {
-            route_load[k] = load;
-            route_dist[k] = dist + instance->service_time * (i - beg - 1);
-            DEBUG(assert(route_dist[k] == compute_route_length(instance, tour + beg, i - beg + 1) + instance->service_time * (i - beg - 1));)
-            k++;
-            load = 0;
-            dist = 0;
+            if (i - beg > 1) {
+                rebuild_route(num_route, tour + beg + 1, i - beg - 1);
+                num_route++;
+            }
             beg = i;
         }
     }
+}
+
+/*
+ * 将链表表示写回 tour, 返回 tour_size
+ */
+int LocalSearch::store_routes(int *tour)
+{
+    int r, x, sentinel, n = 0;
     
-    // 2）step 2: swap
-    for (i = 1; i < tour_size; i++) {
-        n1 = tour[i];
-        if (n1 == 0) {
-            p1++;
+    tour[n++] = 0;
+    for (r = 0; r < num_route; r++) {
+        if (route_count[r] == 0) {
             continue;
         }
-        p_n1 = tour[i-1];
-        s_n1 = tour[i+1];
+        sentinel = num_node + r;
+        for (x = next_node[sentinel]; x != sentinel; x = next_node[x]) {
+            tour[n++] = x;
+        }
+        tour[n++] = 0;
+    }
+    return n;
+}
+
+/*
+ * 用 seq[0..n-1] 重建第r条route的链表与缓存
+ */
+void LocalSearch::rebuild_route(int r, const int *seq, int n)
+{
+    int i, x, prev = num_node + r;
+    int load = 0;
+    double dist = 0;
+    
+    prefix_load[prev] = 0;
+    prefix_count[prev] = 0;
+    prefix_dist[prev] = 0;
+    for (i = 0; i < n; i++) {
+        x = seq[i];
+        load += demand[x];
+        dist += arc(prev, x);
+        next_node[prev] = x;
+        prev_node[x] = prev;
+        route_of[x] = r;
+        prefix_load[x] = load;
+        prefix_count[x] = i + 1;
+        prefix_dist[x] = dist;
+        prev = x;
+    }
+    next_node[prev] = num_node + r;
+    prev_node[num_node + r] = prev;
+    route_of[num_node + r] = r;
+    
+    route_load[r] = load;
+    route_count[r] = n;
+    route_dist[r] = dist + arc(prev, num_node + r);
+}
+
+/*
+ * 将从first到last(含)的点依次追加到seq[n..], 返回新的长度
+ */
+int LocalSearch::append_nodes(int first, int last, int *seq, int n)
+{
+    int x = first;
+    
+    while (TRUE) {
+        seq[n++] = x;
+        if (x == last) {
+            break;
+        }
+        x = next_node[x];
+    }
+    return n;
+}
+
+inline bool LocalSearch::route_feasible(int load, double dist, int count)
+{
+    return load <= vehicle_capacity && dist + service_time * count <= max_distance;
+}
+
+/*
+ FUNCTION:       cross-exchange: segment S1 = u .. e1 (1..MAX_SEGMENT nodes) of
+                 u's route and segment S2 = (the 0..MAX_SEGMENT nodes after v) of
+                 v's route exchange their places, so that u follows v.
+                 S2 empty is relocate, both of one node is swap.
+ INPUT:          u, v in different routes
+ OUTPUT:         TRUE if an improving feasible move was applied
+ */
+bool LocalSearch::try_cross_exchange(int u, int v)
+{
+    int l1, l2;
+    int ru = route_of[u], rv = route_of[v];
+    int su = num_node + ru, sv = num_node + rv;
+    int a1 = prev_node[u], e1, b1;         /* S1 = u .. e1, 前驱a1, 后继b1 */
+    int e2, b2;                            /* S2 = next(v) .. e2, 前驱v, 后继b2 */
+    int load1, load2, n1, n2;
+    double dist1, dist2, old1, old2, new1, new2;
+    
+    e1 = u;
+    for (l1 = 1; l1 <= MAX_SEGMENT; l1++, e1 = next_node[e1]) {
+        if (e1 == su) {
+            break;
+        }
+        b1 = next_node[e1];
+        load1 = prefix_load[e1] - prefix_load[a1];
+        dist1 = prefix_dist[e1] - prefix_dist[u];
+        old1 = arc(a1, u) + dist1 + arc(e1, b1);
         
-        DEBUG(assert(n1 > 0);)
-        p2 = p1;
-        for (j = i+1; j < tour_size; j++) {
-            n2 = tour[j];
-            if (n2 == 0) {
-                p2++;
-                continue;
+        e2 = v;
+        for (l2 = 0; l2 <= MAX_SEGMENT; l2++) {
+            if (l2 > 0) {
+                e2 = next_node[e2];
+                if (e2 == sv) {
+                    break;
+                }
             }
-            p_n2 = tour[j-1];
-            s_n2 = tour[j+1];
+            b2 = next_node[e2];
+            load2 = prefix_load[e2] - prefix_load[v];
             
-            // calulate gain
-            if (j == i + 1) {
-                gain = -(distance[p_n1][n1] + distance[n2][s_n2]) + (distance[p_n1][n2] + distance[n1][s_n2]);
+            /* u的route: a1, S2, b1;  v的route: v, S1, b2 */
+            if (l2 > 0) {
+                dist2 = prefix_dist[e2] - prefix_dist[next_node[v]];
+                old2 = arc(v, next_node[v]) + dist2 + arc(e2, b2);
+                new1 = arc(a1, next_node[v]) + dist2 + arc(e2, b1);
             } else {
-                gain = -(distance[p_n1][n1] + distance[n1][s_n1] + distance[p_n2][n2] + distance[n2][s_n2])
-                +(distance[p_n1][n2] + distance[n2][s_n1] + distance[p_n2][n1] + distance[n1][s_n2]);
+                dist2 = 0;
+                old2 = arc(v, b2);
+                new1 = arc(a1, b1);
             }
-            if (gain < -EPSILON) {
-                
-                // node n1 and n2 not in the same route
-                if (p1 != p2) {
-                    load1 = route_load[p1] - nodes[n1].demand + nodes[n2].demand;
-                    load2 = route_load[p2] - nodes[n2].demand + nodes[n1].demand;
-                    
-                    dist1 = route_dist[p1] - (distance[p_n1][n1] + distance[n1][s_n1]) + (distance[p_n1][n2] + distance[n2][s_n1]);
-                    dist2 = route_dist[p2] - (distance[p_n2][n2] + distance[n2][s_n2]) + (distance[p_n2][n1] + distance[n1][s_n2]);
-                    
-                    if ((load1 > instance->vehicle_capacity || load2 > instance->vehicle_capacity)
-                        || (dist1 > instance->max_distance || dist2 > instance->max_distance)) {
-                        continue;
-                    }
-                } else {
-                    load1 = route_load[p1];
-                    load2 = load1;
-                    
-                    dist1 = route_dist[p1] + gain;   // gain < 0, so dont need to check max_distance limit
-                    dist2 = dist1;
-                }
-                
-                
-                tour[i] = n2;
-                tour[j] = n1;
-
-                route_load[p1] = load1;
-                route_load[p2] = load2;
-                
-                route_dist[p1] = dist1;
-                route_dist[p2] = dist2;
-                
-                i--;
-                
-                DEBUG(assert(check_solution(instance, tour, tour_size));)
-                
-    //                print_solution(instance, tour, tour_size);
-                break;
+            new2 = arc(v, u) + dist1 + arc(e1, b2);
+            
+            if (new1 + new2 - old1 - old2 > -EPSILON) {
+                continue;
             }
+            if (!route_feasible(route_load[ru] - load1 + load2, route_dist[ru] - old1 + new1,
+                                route_count[ru] - l1 + l2)
+                || !route_feasible(route_load[rv] - load2 + load1, route_dist[rv] - old2 + new2,
+                                   route_count[rv] - l2 + l1)) {
+                continue;
+            }
+            
+            /* 执行移动 */
+            n1 = 0;
+            if (a1 != su) {
+                n1 = append_nodes(next_node[su], a1, seq_a, n1);
+            }
+            if (l2 > 0) {
+                n1 = append_nodes(next_node[v], e2, seq_a, n1);
+            }
+            if (b1 != su) {
+                n1 = append_nodes(b1, prev_node[su], seq_a, n1);
+            }
+            
+            n2 = append_nodes(next_node[sv], v, seq_b, 0);
+            n2 = append_nodes(u, e1, seq_b, n2);
+            if (b2 != sv) {
+                n2 = append_nodes(b2, prev_node[sv], seq_b, n2);
+            }
+            
+            rebuild_route(ru, seq_a, n1);
+            rebuild_route(rv, seq_b, n2);
+            num_moves++;
+            route_stamp[ru] = route_stamp[rv] = num_moves;
+            return TRUE;
         }
     }
-    delete[] route_load;
-    delete[] route_dist;
+    return FALSE;
 }
 
+/*
+ FUNCTION:       2-opt*: exchange the tails of two routes so that u is followed
+                 by v, i.e. (head of u's route .. u, v .. tail of v's route) and
+                 (head of v's route .. prev(v), next(u) .. tail of u's route)
+ INPUT:          u, v in different routes
+ OUTPUT:         TRUE if an improving feasible move was applied
+ */
+bool LocalSearch::try_two_opt_star(int u, int v)
+{
+    int n1, n2;
+    int ru = route_of[u], rv = route_of[v];
+    int su = num_node + ru, sv = num_node + rv;
+    int nu = next_node[u], pv = prev_node[v];
+    double dist1, dist2;
+    
+    /* 新的两条route, 距离由前缀和得到 */
+    dist1 = prefix_dist[u] + arc(u, v) + (route_dist[rv] - prefix_dist[v]);
+    dist2 = prefix_dist[pv] + arc(pv, nu) + (route_dist[ru] - prefix_dist[u] - arc(u, nu));
+    
+    if (dist1 + dist2 - route_dist[ru] - route_dist[rv] > -EPSILON) {
+        return FALSE;
+    }
+    if (!route_feasible(prefix_load[u] + route_load[rv] - prefix_load[pv], dist1,
+                        prefix_count[u] + route_count[rv] - prefix_count[pv])
+        || !route_feasible(prefix_load[pv] + route_load[ru] - prefix_load[u], dist2,
+                           prefix_count[pv] + route_count[ru] - prefix_count[u])) {
+        return FALSE;
+    }
+    
+    n1 = append_nodes(next_node[su], u, seq_a, 0);
+    n1 = append_nodes(v, prev_node[sv], seq_a, n1);
+    n2 = 0;
+    if (pv != sv) {
+        n2 = append_nodes(next_node[sv], pv, seq_b, n2);
+    }
+    if (nu != su) {
+        n2 = append_nodes(nu, prev_node[su], seq_b, n2);
+    }
+    
+    rebuild_route(ru, seq_a, n1);
+    rebuild_route(rv, seq_b, n2);
+    num_moves++;
+    route_stamp[ru] = route_stamp[rv] = num_moves;
+    return TRUE;
+}
@@ -21,7 +21,10 @@ class LocalSearch {
 public:
     
     LocalSearch(Problem *instance);
-    ~LocalSearch(){}
+    ~LocalSearch();
+    void sync_instance(void);
+    
+    Rng *rng;               /* 随机数流, 默认是问题的流; 蚁群工作线程中是线程私有的流 */
     
     void do_local_search(void);
     void do_local_search(AntStruct *ant);
@@ -33,17 +36,67 @@ private:
     AntStruct *ants;
     int n_ants;
     bool ls_flag;
-    double **distance;
+    DistanceMatrix distance;
     int num_node;
     int **nn_list;
     int nn_ls;
     bool dlb_flag;
+    bool or_opt_flag;
+    bool or3_opt_flag;
+    bool inter_ls_flag;
+    int *demand;
+    int vehicle_capacity;
+    double max_distance;
+    double service_time;
+    
+    /* 2-opt 使用的缓冲区, 按 num_node 分配一次; 每次使用后只清除用过的项, 保持全为FALSE */
+    int buffer_size;
+    bool *dlb;               /* vector containing don't look bits */
+    bool *route_node_map;    /* mark for all nodes in a single route */
+    int *tour_node_pos;      /* positions of nodes in tour */
+    
+    /*
+     * 跨route局部搜索: solution 表示为双向循环链表, 第r条route的哨兵(depot)为 num_node + r.
+     * 对每个点缓存从route起点到该点(含)的 load/距离/点数, 对每条route缓存总量,
+     * 这样任意一次移动的增益与可行性(容量, 最大行驶距离含service time)都是O(1)计算
+     */
+    int *next_node;          /* 后继, 下标为点或哨兵 */
+    int *prev_node;          /* 前驱 */
+    int *route_of;           /* 点所在的route */
+    int *prefix_load;        /* route起点到该点(含)的load, 哨兵为0 */
+    int *prefix_count;       /* route起点到该点(含)的点数, 哨兵为0 */
+    double *prefix_dist;     /* route起点到该点的距离, 哨兵为0 */
+    int *route_load;         /* route的总load */
+    int *route_count;        /* route的点数 */
+    double *route_dist;      /* route的总距离(不含service time) */
+    int num_route;
+    int num_moves;           /* 已执行的移动数, 作为时间戳 */
+    int *route_stamp;        /* route最后一次被修改时的num_moves */
+    int *node_stamp;         /* 点最后一次完整搜索(无改进)时的num_moves */
+    int *ls_order;           /* 搜索顺序: 按tour中的顺序的所有配送点 */
+    int *seq_a, *seq_b;      /* 执行移动时重建route用 */
     
-    void two_opt_solution(int *tour, int tour_size);
-    void swap(int *tour, int tour_size);
+    void intra_route_solution(int *tour, int tour_size);
+    int inter_route_solution(int *tour, int tour_size);
     int * generate_random_permutation( int n );
     void two_opt_single_route(int *tour, int rbeg, int rend, bool *dlb,
                               bool *route_node_map, int *tour_node_pos);
+    int or_opt_single_route(int *tour, int rbeg, int rend, bool *dlb,
+                            bool *route_node_map, int *tour_node_pos);
+    
+    void free_buffers(void);
+    void load_routes(int *tour, int tour_size);
+    int store_routes(int *tour);
+    void rebuild_route(int r, const int *seq, int n);
+    int append_nodes(int first, int last, int *seq, int n);
+    bool route_feasible(int load, double dist, int count);
+    bool try_cross_exchange(int u, int v);
+    bool try_two_opt_star(int u, int v);
+    
+    /* 两点之间的距离, 哨兵即depot */
+    inline double arc(int i, int j) {
+        return distance(i < num_node ? i : 0, j < num_node ? j : 0);
+    }
 };
 
 #endif /* localSearch_h */
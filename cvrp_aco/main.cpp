@@ -10,30 +10,34 @@
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
+#include <unistd.h>
+#include <vector>
 
 #include "utilities.h"
 #include "antColony.h"
 #include "parallelAco.h"
+#include "islandAco.h"
 #include "simulatedAnnealing.h"
 #include "problem.h"
 #include "timer.h"
 #include "io.h"
+#include "threadPool.h"
 
 static bool parallel_flag  = true;  /* 是否使用并行算法 */
+static bool island_flag    = false; /* 是否使用island model(多个独立蚁群交换最优解) */
 static int tries = 15;
+static int parallel_tries = 1;      /* 同时运行的try个数, 0表示每个核一个try; 1: 各try依次运行, 每个try使用全部核 */
 
 /*
- FUNCTION:       checks whether termination condition is met
- INPUT:          none
- OUTPUT:         0 if condition is not met, number neq 0 otherwise
- (SIDE)EFFECTS:  none
+ * 一次独立的try, 拥有自己的Problem(参数、随机数种子、计时起点和report文件)
  */
-bool termination_condition(Problem *instance)
-{
-    return ((instance->iteration >= instance->max_iteration) ||
-            (elapsed_time( REAL ) >= instance->max_runtime) ||
-            (fabs(instance->best_so_far_ant->tour_length - instance->optimum) < 10 * EPSILON));
-}
+struct TryInfo {
+    const char *filename;
+    int ntry;
+    int rnd_seed;
+    int num_threads;               /* 该try内部可用的线程数 */
+    SolverConfig config;           /* 该try的调节参数, 可以每个try不同(参数扫描) */
+};
 
 /*
  * 解析命令行，获取文件名
@@ -51,55 +55,115 @@ char* parse_commandline (int argc, char *argv [])
     return filename;
 }
 
+/*
+ FUNCTION:       run a single independent trial
+ INPUT:          pointer to the TryInfo of the trial
+ OUTPUT:         none
+ (SIDE)EFFECTS:  writes the report files of the trial
+ */
+void *run_try(void *in)
+{
+    TryInfo *info = (TryInfo *)in;
+    Problem *instance = new Problem(0);
+    AntColony *solver;
+    Deadline deadline;
+    
+    instance->start_time = real_clock();
+    instance->config = info->config;
+    init_deadline(&deadline, instance->config.max_runtime);
+    instance->deadline = &deadline;
+    instance->rnd_seed = info->rnd_seed;
+    
+    read_instance_file(instance, info->filename);
+    init_problem(instance);
+    instance->num_threads = MAX(MIN(instance->num_threads, info->num_threads), 1);
+    init_report(instance, info->ntry);
+    
+    printf("Initialization took %.10f seconds\n", elapsed_run_time(instance));
+    
+    if (island_flag) {
+        instance->num_threads = 1;      /* 每个岛一个线程 */
+        instance->num_islands = MAX(MIN(instance->num_islands, info->num_threads), 1);
+        solver = new IslandAco(instance);
+    } else if (parallel_flag && instance->num_subs > 1) {
+        /* pipeline 时主问题与子问题同时求解, 两者平分该try的线程; 只有一个线程时不使用pipeline */
+        if (instance->num_threads < 2) {
+            instance->config.pipeline_flag = false;
+        }
+        if (instance->config.pipeline_flag) {
+            instance->num_sub_threads = instance->num_threads / 2;
+            instance->num_threads -= instance->num_sub_threads;
+        } else {
+            instance->num_sub_threads = instance->num_threads;
+        }
+        solver = new ParallelAco(instance);
+    } else {
+        solver = new AntColony(instance);
+    }
+    
+    solver->init_aco();
+    
+    while (!termination_condition(instance)) {
+        solver->run_aco_iteration();
+        instance->iteration++;
+    }
+    
+    // 达到最大迭代次数或最优解时, 让仍在后台求解的子问题尽快结束
+    cancel_deadline(&deadline);
+    solver->exit_aco();
+    
+    delete solver;
+    
+    exit_report(instance, info->ntry);
+    exit_problem(instance);
+    return NULL;
+}
+
 /* --- main program ------------------------------------------------------ */
 /*
  FUNCTION:       main control for running the ACO algorithms
  INPUT:          none
  OUTPUT:         none
  (SIDE)EFFECTS:  none
- COMMENTS:       this function controls the run of "max_tries" independent trials
- 
+ COMMENTS:       this function controls the run of "max_tries" independent trials,
+                 parallel_tries of them run at the same time, the cores are
+                 shared evenly among the running trials
  */
 int main(int argc, char *argv[])
 {
+    int nproc = MAX((int)sysconf(_SC_NPROCESSORS_ONLN), 1);
+    int seed = (int)time(NULL);
+    
+    if (parallel_tries <= 0) {
+        parallel_tries = nproc;
+    }
+    parallel_tries = MIN(parallel_tries, tries);
+    
     for (int i = 3; i <= 3; i++) {
-    for (int ntry = 0 ; ntry < tries; ntry++)
-    {
-        Problem *instance = new Problem(0);
-        AntColony *solver;
-        
-        start_timers();
-        
         char *filename = parse_commandline(argc, argv);
         sprintf(filename, "../dataset/CMT/CMT%d.vrp", i);
 //        sprintf(filename, "../dataset/Golden/Golden_%d.vrp", i);
         
-        read_instance_file(instance, filename);
-        init_problem(instance);
-        init_report(instance, ntry);
+        vector<TryInfo> infos(tries);
+        ThreadPool *pool = new ThreadPool(parallel_tries);
         
-        printf("Initialization took %.10f seconds\n", elapsed_time(REAL));
-
-        if (parallel_flag && instance->num_subs > 1) {
-            solver = new ParallelAco(instance);
-        } else {
-            solver = new AntColony(instance);
-        }
-        
-        solver->init_aco();
-        
-        while (!termination_condition(instance)) {
-            solver->run_aco_iteration();
-            instance->iteration++;
+        start_timers();
+        for (int ntry = 0 ; ntry < tries; ntry++) {
+            infos[ntry].filename = filename;
+            infos[ntry].ntry = ntry;
+            /* 并发的try在同一秒开始, 种子由同一序列派生以保证各try不同 */
+            infos[ntry].rnd_seed = random_number(&seed);
+            if (infos[ntry].rnd_seed == 0) {
+                infos[ntry].rnd_seed = 1;
+            }
+            infos[ntry].num_threads = MAX(nproc / parallel_tries, 1);
+            default_solver_config(&infos[ntry].config);
+            pool->submit(run_try, (void *)&infos[ntry]);
         }
-
-        solver->exit_aco();
+        pool->wait();
+        delete pool;
         
-        delete solver;
-        
-        exit_report(instance, ntry);
-        exit_problem(instance);
-    }
+        printf("%d tries took %.2f seconds\n", tries, elapsed_time(REAL));
     }
     
     return(0);
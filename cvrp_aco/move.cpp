@@ -11,72 +11,52 @@
 #include "move.h"
 
 /*
- * exchange node[pos_n1] and node[pos_n2]
- * pos_n1 < pos_n2
+ * apply the move to the tour of ant
  */
-void ExchangeMove::apply()
+void Move::apply(AntStruct *ant) const
 {
     int *tour = ant->tour;
+    int tmp, i, j;
     
-    int tmp = tour[pos_n1];
-    tour[pos_n1] = tour[pos_n2];
-    tour[pos_n2] = tmp;
-    
-    ant->tour_length += gain;
-}
-
-/*
- * if pos_n1 < pos_n2, then insert node[pos_n1] after node[pos_n2]
- * if pos_n1 > pos_n2, then insert node[pos_n1] before node[pos_n1]
- */
-void InsertionMove::apply()
-{
-    int *tour = ant->tour;
-    int tmp = tour[pos_n1];
-    int i;
-    
-    if (pos_n1 < pos_n2) {
-        for (i = pos_n1; i < pos_n2; i++) {
-            tour[i] = tour[i+1];
-        }
-        tour[pos_n2] = tmp;
-    } else {
-        for (i = pos_n1; i > pos_n2; i--) {
-            tour[i] = tour[i-1];
-        }
-        tour[pos_n2] = tmp;
-    }
-    
-    ant->tour_length += gain;
-}
-
-/*
- * reverse nodes(in the same route) between pos_n1 and pos_n2,
- * pos_n1 and pos_n2 included.
- */
-void InversionMove::apply()
-{
-    int *tour = ant->tour;
-    int i, j;
-    int tmp;
-    
-    if (pos_n1 > pos_n2) {
-        tmp = pos_n1;
-        pos_n1 = pos_n2;
-        pos_n2 = tmp;
-    }
-    
-    i = pos_n1;
-    j = pos_n2;
-    DEBUG(assert(pos_n1 < pos_n2);)
-    while (i < j) {
-        tmp = tour[i];
-        tour[i] = tour[j];
-        tour[j] = tmp;
-        i++;
-        j--;
+    switch (type) {
+        case EXCHANGE_MOVE:
+            /* exchange node[pos_n1] and node[pos_n2] */
+            tmp = tour[pos_n1];
+            tour[pos_n1] = tour[pos_n2];
+            tour[pos_n2] = tmp;
+            break;
+            
+        case INSERTION_MOVE:
+            /*
+             * if pos_n1 < pos_n2, then insert node[pos_n1] after node[pos_n2]
+             * if pos_n1 > pos_n2, then insert node[pos_n1] before node[pos_n1]
+             */
+            tmp = tour[pos_n1];
+            if (pos_n1 < pos_n2) {
+                for (i = pos_n1; i < pos_n2; i++) {
+                    tour[i] = tour[i+1];
+                }
+            } else {
+                for (i = pos_n1; i > pos_n2; i--) {
+                    tour[i] = tour[i-1];
+                }
+            }
+            tour[pos_n2] = tmp;
+            break;
+            
+        case INVERSION_MOVE:
+            /* reverse nodes(in the same route) between pos_n1 and pos_n2, both included */
+            i = MIN(pos_n1, pos_n2);
+            j = MAX(pos_n1, pos_n2);
+            while (i < j) {
+                tmp = tour[i];
+                tour[i] = tour[j];
+                tour[j] = tmp;
+                i++;
+                j--;
+            }
+            break;
     }
     
     ant->tour_length += gain;
 }
-
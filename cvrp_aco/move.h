@@ -16,56 +16,35 @@ enum MoveType{
     EXCHANGE_MOVE, INSERTION_MOVE, INVERSION_MOVE
 };
 
+/*
+ * SA的邻域移动. 值类型, 由 NeighbourSearch::search 写入调用者预先分配的Move中, 不在堆上分配.
+ * r1/r2 及新的 load/dist 用于应用移动后增量更新route信息
+ */
 class Move {
 public:
-    Move(AntStruct *ant_, bool valid_, double gain_, int pos_n1_, int pos_n2_, MoveType type_)
-    :ant(ant_), valid(valid_), gain(gain_), pos_n1(pos_n1_), pos_n2(pos_n2_), type(type_){}
-    virtual ~Move(){}
-    virtual void apply(){}
+    Move():type(EXCHANGE_MOVE), valid(false), gain(0), pos_n1(0), pos_n2(0),
+    r1(0), r2(0), load_r1(0), load_r2(0), dist_r1(0), dist_r2(0){}
     
-    AntStruct *ant;
+    void set(MoveType type_, bool valid_, double gain_, int pos_n1_, int pos_n2_,
+             int r1_, int r2_, int load_r1_, int load_r2_, double dist_r1_, double dist_r2_)
+    {
+        type = type_; valid = valid_; gain = gain_; pos_n1 = pos_n1_; pos_n2 = pos_n2_;
+        r1 = r1_; r2 = r2_; load_r1 = load_r1_; load_r2 = load_r2_; dist_r1 = dist_r1_; dist_r2 = dist_r2_;
+    }
+    void apply(AntStruct *ant) const;
+    
+    MoveType type;            /* move type */
     bool valid;
     double   gain;
     int pos_n1;          /* 两个互换位置的node idx */
     int pos_n2;
     
-    MoveType type;            /* move type */
-};
-
-class ExchangeMove : public Move {
-public:
-    ExchangeMove(AntStruct *ant_, bool valid_, double gain_, int pos_n1_, int pos_n2_,
-                 int load_r1_, int load_r2_)
-    :Move(ant_, valid_, gain_, pos_n1_, pos_n2_, EXCHANGE_MOVE), load_r1(load_r1_), load_r2(load_r2_){}
-    ~ExchangeMove(){}
-    
-    void apply();
-    
-    int load_r1;         /* new load of route 1 */
-    int load_r2;         /* new load of route 2 */
-};
-
-
-class InsertionMove : public Move {
-public:
-    InsertionMove(AntStruct *ant_, bool valid_, double gain_, int pos_n1_, int pos_n2_,
-                 int load_r1_, int load_r2_)
-    :Move(ant_, valid_, gain_, pos_n1_, pos_n2_, INSERTION_MOVE), load_r1(load_r1_), load_r2(load_r2_){}
-    ~InsertionMove(){}
-    
-    void apply();
-
+    int r1;              /* pos_n1 与 pos_n2 所在的route */
+    int r2;
     int load_r1;         /* new load of route 1 */
     int load_r2;         /* new load of route 2 */
-};
-
-class InversionMove : public Move {
-public:
-    InversionMove(AntStruct *ant_, bool valid_, double gain_, int pos_n1_, int pos_n2_)
-    :Move(ant_, valid_, gain_, pos_n1_, pos_n2_, INVERSION_MOVE){}
-    ~InversionMove(){}
-    
-    void apply();
+    double dist_r1;      /* new distance of route 1 (不含service time) */
+    double dist_r2;      /* new distance of route 2 */
 };
 
 #endif /* move_h */
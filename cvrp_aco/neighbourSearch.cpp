@@ -17,27 +17,74 @@
 #include <cstdlib>
 #include <math.h>
 #include <assert.h>
-#include<time.h>
 
 #include "neighbourSearch.h"
 #include "utilities.h"
+#include "vrpHelper.h"
 #include "io.h"
 
 using namespace std;
-
-NeighbourSearch::NeighbourSearch(Problem *instance)
+NeighbourSearch::NeighbourSearch(Problem *instance, Rng *rng)
 {
-    srandom((unsigned int)time(NULL));
+    int k;
+    int n = MAX(instance->config.sa_batch_size, 1);
+    
     this->instance = instance;
+    this->rng = rng;
+    
+    batch.size = 0;
+    batch.capacity = n;
+    for (k = 0; k < BATCH_EDGES; k++) {
+        batch.from[k] = new int[n];
+        batch.to[k] = new int[n];
+    }
+    batch.type = new MoveType[n];
+    batch.pos_n1 = new int[n];
+    batch.pos_n2 = new int[n];
+    batch.r1 = new int[n];
+    batch.r2 = new int[n];
+    batch.load_r1 = new int[n];
+    batch.load_r2 = new int[n];
+    batch.base_r1 = new double[n];
+    batch.base_r2 = new double[n];
+    batch.shared = new double[n];
+    batch.limit_r1 = new double[n];
+    batch.limit_r2 = new double[n];
+    batch.gain = new double[n];
+    batch.dist_r1 = new double[n];
+    batch.dist_r2 = new double[n];
+    batch.valid = new char[n];
 }
 
 NeighbourSearch::~NeighbourSearch()
 {
     routes.clear();
+    
+    for (int k = 0; k < BATCH_EDGES; k++) {
+        delete[] batch.from[k];
+        delete[] batch.to[k];
+    }
+    delete[] batch.type;
+    delete[] batch.pos_n1;
+    delete[] batch.pos_n2;
+    delete[] batch.r1;
+    delete[] batch.r2;
+    delete[] batch.load_r1;
+    delete[] batch.load_r2;
+    delete[] batch.base_r1;
+    delete[] batch.base_r2;
+    delete[] batch.shared;
+    delete[] batch.limit_r1;
+    delete[] batch.limit_r2;
+    delete[] batch.gain;
+    delete[] batch.dist_r1;
+    delete[] batch.dist_r2;
+    delete[] batch.valid;
 }
 
+
 /*
- *
+ * 设置要搜索的ant, 建立其route信息. 之后ant只能通过 apply 修改
  */
 void NeighbourSearch::reset_ant(AntStruct *ant)
 {
@@ -55,7 +102,7 @@ void NeighbourSearch::reset_ant(AntStruct *ant)
     dist = 0;
     for (int i = 1; i < ant->tour_size; i++) {
         load += nodes[tour[i]].demand;
-        dist += instance->distance[tour[i-1]][tour[i]];
+        dist += instance->distance(tour[i-1], tour[i]);
         
         if (tour[i] == 0) {
             Route route(beg, i, load, dist);
@@ -68,52 +115,194 @@ void NeighbourSearch::reset_ant(AntStruct *ant)
     }
 }
 
+/*
+ * 随机生成一个邻域移动, 写入move; 没有可用的移动时返回false.
+ * 超过车辆容量的移动 valid 为false, 其gain没有意义
+ */
+bool NeighbourSearch::search(Move *move)
+{
+    if (search_batch(1) == 0) {
+        return false;
+    }
+    get_move(0, move);
+    return true;
+}
 
-Move *NeighbourSearch::search(AntStruct *ant)
+/*
+ * 随机采样n个邻域移动(n <= batch.capacity)并评估, 结果在batch中, 返回实际生成的移动数.
+ * 所有候选都相对于当前的ant, 应用其中一个之后其余的失效
+ */
+int NeighbourSearch::search_batch(int n)
 {
-    // 首先需要reset solution
-    reset_ant(ant);
+    int i;
     
+    batch.size = 0;
+    for (i = 0; i < n; i++) {
+        if (sample(batch.size)) {
+            batch.size++;
+        }
+    }
+    evaluate();
+    return batch.size;
+}
+
+/*
+ * 将batch中的第i个移动写入move
+ */
+void NeighbourSearch::get_move(int i, Move *move) const
+{
+    move->set(batch.type[i], batch.valid[i] != 0, batch.gain[i], batch.pos_n1[i], batch.pos_n2[i],
+              batch.r1[i], batch.r2[i], batch.load_r1[i], batch.load_r2[i],
+              batch.dist_r1[i], batch.dist_r2[i]);
+}
+
+/*
+ * 随机选择一种移动写入batch的第i个位置; 没有可用的移动时返回false
+ */
+bool NeighbourSearch::sample(int i)
+{
     int *tour = ant->tour;
-    int tour_size = ant->tour_size;
     
-    int rnd = random() % 3;
+    int rnd = rng_int(rng, 3);
     switch (rnd) {
         case 0:
-            return exchange(tour, tour_size);
+            exchange(tour, i);
             break;
         case 1:
-            return insertion(tour, tour_size);
+            insertion(tour, i);
             break;
         case 2:
-            return inversion(tour, tour_size);
-            break;
+            return inversion(tour, i);
         default:
-            return exchange(tour, tour_size);
+            exchange(tour, i);
             break;
     }
+    return true;
+}
+
+/*
+ * 计算batch中所有移动的gain、新的route距离与可行性.
+ * 各移动的计算方式相同, 没有分支, 距离矩阵的读取集中在一起
+ */
+void NeighbourSearch::evaluate(void)
+{
+    DistanceMatrix &distance = instance->distance;
+    int capacity = instance->vehicle_capacity;
+    int n = batch.size;
+    int **from = batch.from;
+    int **to = batch.to;
+    double d1, d2;
+    
+    for (int i = 0; i < n; i++) {
+        d1 = distance(from[2][i], to[2][i]) + distance(from[3][i], to[3][i])
+            - distance(from[0][i], to[0][i]) - distance(from[1][i], to[1][i]);
+        d2 = distance(from[6][i], to[6][i]) + distance(from[7][i], to[7][i])
+            - distance(from[4][i], to[4][i]) - distance(from[5][i], to[5][i]);
+        
+        batch.gain[i] = d1 + d2;
+        batch.dist_r1[i] = batch.base_r1[i] + d1 + batch.shared[i] * d2;
+        batch.dist_r2[i] = batch.base_r2[i] + d2 + batch.shared[i] * d1;
+        batch.valid[i] = (batch.load_r1[i] <= capacity) & (batch.load_r2[i] <= capacity)
+            & (batch.dist_r1[i] <= batch.limit_r1[i]) & (batch.dist_r2[i] <= batch.limit_r2[i]);
+    }
+}
+
+/*
+ * 记录第i个候选移动, 其边先全部置为(0,0).
+ * size_r1/size_r2: 移动后route中配送点的个数, 用于计算service time.
+ * 超过车辆容量时返回false, 调用者不再设置边: 该移动不可行, 评估时只读取距离矩阵中的(0,0)
+ */
+bool NeighbourSearch::set_candidate(int i, MoveType type, int pos_n1, int pos_n2, int r1, int r2,
+                                    int load_r1, int load_r2, int size_r1, int size_r2)
+{
+    for (int k = 0; k < BATCH_EDGES; k++) {
+        batch.from[k][i] = 0;
+        batch.to[k][i] = 0;
+    }
+    batch.type[i] = type;
+    batch.pos_n1[i] = pos_n1;
+    batch.pos_n2[i] = pos_n2;
+    batch.r1[i] = r1;
+    batch.r2[i] = r2;
+    batch.load_r1[i] = load_r1;
+    batch.load_r2[i] = load_r2;
+    batch.base_r1[i] = routes[r1].dist;
+    batch.base_r2[i] = routes[r2].dist;
+    batch.shared[i] = r1 == r2 ? 1.0 : 0.0;
+    batch.limit_r1[i] = instance->max_distance - size_r1 * instance->service_time;
+    batch.limit_r2[i] = instance->max_distance - size_r2 * instance->service_time;
+    
+    return load_r1 <= instance->vehicle_capacity && load_r2 <= instance->vehicle_capacity;
+}
+
+/*
+ * 第i个候选移动的第k条边, 见 BATCH_EDGES
+ */
+void NeighbourSearch::set_edge(int i, int k, int from, int to)
+{
+    batch.from[k][i] = from;
+    batch.to[k][i] = to;
+}
+
+/*
+ * 应用move, 并增量更新route信息:
+ * 只有不同route间的insertion会移动route边界, 被平移的route都位于两个route之间, 与数组平移的代价相同
+ */
+void NeighbourSearch::apply(const Move *move)
+{
+    int r;
+    
+    move->apply(ant);
+    
+    routes[move->r1].load = move->load_r1;
+    routes[move->r1].dist = move->dist_r1;
+    routes[move->r2].load = move->load_r2;
+    routes[move->r2].dist = move->dist_r2;
+    
+    if (move->type == INSERTION_MOVE && move->r1 != move->r2) {
+        if (move->r1 < move->r2) {
+            /* node 从 r1 向后移到 r2 */
+            routes[move->r1].end--;
+            for (r = move->r1 + 1; r < move->r2; r++) {
+                routes[r].beg--;
+                routes[r].end--;
+            }
+            routes[move->r2].beg--;
+        } else {
+            /* node 从 r1 向前移到 r2 */
+            routes[move->r2].end++;
+            for (r = move->r2 + 1; r < move->r1; r++) {
+                routes[r].beg++;
+                routes[r].end++;
+            }
+            routes[move->r1].beg++;
+        }
+    }
+    
+    DEBUG(for (r = 0; r < routes.size(); r++) {
+        assert(ant->tour[routes[r].beg] == 0 && ant->tour[routes[r].end] == 0);
+        assert(fabs(routes[r].dist - compute_route_length(instance, ant->tour + routes[r].beg,
+                                                           routes[r].end - routes[r].beg + 1)) < 1e-6);
+    })
 }
 
 /*
  * function: randomly exchanging two nodes from two routes
  */
-Move *NeighbourSearch::exchange(int *tour, int tour_size)
+void NeighbourSearch::exchange(int *tour, int i)
 {
     int n1, n2;          /* random node from route 1 and toure 2*/
     int p_n1, p_n2, s_n1, s_n2;
     int pos_n1 = 0, pos_n2 = 0;
     int r1, r2;           /* idx of route 1 and route 2 */
-    double gain;
-    double **distance = instance->distance;
     Point *nodes = instance->nodeptr;
     int load_r1, load_r2;
-    double dist_r1, dist_r2;
-    bool valid = true;
     
     r1 = random_route();
     r2 = random_route();
     if (r1 == r2) {
-        return exchange_1(tour, tour_size);
+        exchange_1(tour, i);
+        return;
     }
     
     n1 = 0;
@@ -137,44 +326,39 @@ Move *NeighbourSearch::exchange(int *tour, int tour_size)
     s_n1 = tour[pos_n1+1];
     s_n2 = tour[pos_n2+1];
     
-    gain = -(distance[p_n1][n1] + distance[n1][s_n1] + distance[p_n2][n2] + distance[n2][s_n2])
-    +(distance[p_n1][n2] + distance[n2][s_n1] + distance[p_n2][n1] + distance[n1][s_n2]);
-    
-    dist_r1 = routes[r1].dist + (routes[r1].end - routes[r1].beg - 1) * instance->service_time
-    - (distance[p_n1][n1] + distance[n1][s_n1]) + (distance[p_n1][n2] + distance[n2][s_n1]);
-    
-    dist_r2 = routes[r2].dist + (routes[r2].end - routes[r2].beg - 1) * instance->service_time
-    - (distance[p_n2][n2] + distance[n2][s_n2]) + (distance[p_n2][n1] + distance[n1][s_n2]);
-    
     load_r1 = routes[r1].load - nodes[n1].demand + nodes[n2].demand;
     load_r2 = routes[r2].load - nodes[n2].demand + nodes[n1].demand;
     
-    if ((load_r1 > instance->vehicle_capacity || load_r2 > instance->vehicle_capacity)
-        ||(dist_r1 > instance->max_distance || dist_r2 > instance->max_distance))
-    {
-        valid = false;
+    if (!set_candidate(i, EXCHANGE_MOVE, pos_n1, pos_n2, r1, r2, load_r1, load_r2,
+                       routes[r1].end - routes[r1].beg - 1, routes[r2].end - routes[r2].beg - 1)) {
+        return;
     }
-    return new ExchangeMove(ant, valid, gain, pos_n1, pos_n2, load_r1, load_r2);
+    set_edge(i, 0, p_n1, n1);
+    set_edge(i, 1, n1, s_n1);
+    set_edge(i, 2, p_n1, n2);
+    set_edge(i, 3, n2, s_n1);
+    set_edge(i, 4, p_n2, n2);
+    set_edge(i, 5, n2, s_n2);
+    set_edge(i, 6, p_n2, n1);
+    set_edge(i, 7, n1, s_n2);
 }
 
 /*
  * function: randomly exchanging two non-zero nodes from one route
  */
-Move *NeighbourSearch::exchange_1(int *tour, int tour_size)
+void NeighbourSearch::exchange_1(int *tour, int i)
 {
     Route *route = NULL;
+    int r = 0;
     int n1, n2;
     int p_n1, p_n2, s_n1, s_n2;
     int pos_n1, pos_n2;
-    double gain;
-    double **distance = instance->distance;
     int sz;
-    double dist;
-    bool valid = true;
     
     sz = 0;
     while (sz <= 3) {
-        route = &routes[random_route()];
+        r = random_route();
+        route = &routes[r];
         sz = route->end - route->beg + 1;
     }
     
@@ -204,19 +388,22 @@ Move *NeighbourSearch::exchange_1(int *tour, int tour_size)
     s_n1 = tour[pos_n1+1];
     s_n2 = tour[pos_n2+1];
     
+    set_candidate(i, EXCHANGE_MOVE, pos_n1, pos_n2, r, r, route->load, route->load, sz - 2, sz - 2);
     if (pos_n2 - pos_n1 == 1) {
-        gain = -(distance[p_n1][n1] + distance[n2][s_n2]) +(distance[p_n1][n2] + distance[n1][s_n2]);
+        set_edge(i, 0, p_n1, n1);
+        set_edge(i, 1, n2, s_n2);
+        set_edge(i, 2, p_n1, n2);
+        set_edge(i, 3, n1, s_n2);
     } else {
-        gain = -(distance[p_n1][n1] + distance[n1][s_n1] + distance[p_n2][n2] + distance[n2][s_n2])
-        +(distance[p_n1][n2] + distance[n2][s_n1] + distance[p_n2][n1] + distance[n1][s_n2]);
-    }
-    
-    dist = route->dist + (route->end - route->beg - 1) * instance->service_time + gain;
-    if(dist > instance->max_distance) {
-        valid = false;
+        set_edge(i, 0, p_n1, n1);
+        set_edge(i, 1, n1, s_n1);
+        set_edge(i, 2, p_n1, n2);
+        set_edge(i, 3, n2, s_n1);
+        set_edge(i, 4, p_n2, n2);
+        set_edge(i, 5, n2, s_n2);
+        set_edge(i, 6, p_n2, n1);
+        set_edge(i, 7, n1, s_n2);
     }
-    
-    return new ExchangeMove(ant, valid, gain, pos_n1, pos_n2, route->load, route->load);
 }
 
 /*
@@ -224,19 +411,14 @@ Move *NeighbourSearch::exchange_1(int *tour, int tour_size)
  * if pos_n1 < pos_n2, then insert node[pos_n1] after node[pos_n2]
  * if pos_n1 > pos_n2, then insert node[pos_n1] before node[pos_n1]
  */
-Move *NeighbourSearch::insertion(int *tour, int tour_size)
+void NeighbourSearch::insertion(int *tour, int i)
 {
     Route *route1, *route2;
     int n1, n2;   /* random node from route 1 and toure 2*/
     int p_n1, p_n2, s_n1, s_n2;
     int pos_n1, pos_n2;
     int r1 = 0, r2;           /* idx of route 1 and route 2 */
-    double gain;
-    double **distance = instance->distance;
     Point *nodes = instance->nodeptr;
-    int load_r1, load_r2;
-    double dist_r2;
-    bool valid = true;
     int sz;
     
     sz = 0;
@@ -247,7 +429,8 @@ Move *NeighbourSearch::insertion(int *tour, int tour_size)
     
     r2 = random_route();
     if (r1 == r2) {
-        return insertion_1(tour, tour_size);
+        insertion_1(tour, i);
+        return;
     }
     
     // r1 != r2
@@ -277,29 +460,24 @@ Move *NeighbourSearch::insertion(int *tour, int tour_size)
     s_n1 = tour[pos_n1+1];
     s_n2 = tour[pos_n2+1];
     
+    // r1少了一个元素, r2多了一个元素
+    if (!set_candidate(i, INSERTION_MOVE, pos_n1, pos_n2, r1, r2,
+                       route1->load - nodes[n1].demand, route2->load + nodes[n1].demand,
+                       route1->end - route1->beg - 2, route2->end - route2->beg)) {
+        return;
+    }
+    set_edge(i, 0, p_n1, n1);
+    set_edge(i, 1, n1, s_n1);
+    set_edge(i, 2, p_n1, s_n1);
     if (pos_n1 > pos_n2) {
-        gain = -(distance[p_n1][n1] + distance[n1][s_n1] + distance[p_n2][n2])
-        + (distance[n1][n2] + distance[p_n2][n1] + distance[p_n1][s_n1]);
-        // r2多了一个元素
-        dist_r2 = route2->dist + (route2->end - route2->beg) * instance->service_time
-        - (distance[p_n2][n2]) + (distance[n1][n2] + distance[p_n2][n1]);
-        
+        set_edge(i, 4, p_n2, n2);
+        set_edge(i, 6, n1, n2);
+        set_edge(i, 7, p_n2, n1);
     } else {
-        gain = -(distance[p_n1][n1] + distance[n1][s_n1] + distance[n2][s_n2])
-        + (distance[n2][n1] + distance[n1][s_n2] + distance[p_n1][s_n1]);
-        
-        dist_r2 = route2->dist + (route2->end - route2->beg) * instance->service_time
-        - (distance[n2][s_n2]) + (distance[n2][n1] + distance[n1][s_n2]);
-        
-    }
-    
-    load_r1 = route1->load - nodes[n1].demand;
-    load_r2 = route2->load + nodes[n1].demand;
-    
-    if (load_r2 > instance->vehicle_capacity || dist_r2 > instance->max_distance) {
-        valid = false;
+        set_edge(i, 4, n2, s_n2);
+        set_edge(i, 6, n2, n1);
+        set_edge(i, 7, n1, s_n2);
     }
-    return new InsertionMove(ant, valid, gain, pos_n1, pos_n2, load_r1, load_r2);
 }
 
 /*
@@ -307,22 +485,19 @@ Move *NeighbourSearch::insertion(int *tour, int tour_size)
  * if pos_n1 < pos_n2, then insert node[pos_n1] after node[pos_n2]
  * if pos_n1 > pos_n2, then insert node[pos_n1] before node[pos_n1]
  */
-Move *NeighbourSearch::insertion_1(int *tour, int tour_size)
+void NeighbourSearch::insertion_1(int *tour, int i)
 {
     Route *route = NULL;
+    int r = 0;
     int n1, n2;
     int p_n1, p_n2, s_n1, s_n2;
     int pos_n1, pos_n2;
-    double gain;
-    double **distance = instance->distance;
-    int load_r1, load_r2;
-    double dist;
     int sz;
-    bool valid = true;
     
     sz = 0;
     while (sz <= 3) {
-        route = &routes[random_route()];
+        r = random_route();
+        route = &routes[r];
         sz = route->end - route->beg + 1;
     }
     
@@ -348,42 +523,40 @@ Move *NeighbourSearch::insertion_1(int *tour, int tour_size)
     s_n1 = tour[pos_n1+1];
     s_n2 = tour[pos_n2+1];
     
+    set_candidate(i, INSERTION_MOVE, pos_n1, pos_n2, r, r, route->load, route->load, sz - 2, sz - 2);
+    set_edge(i, 0, p_n1, n1);
+    set_edge(i, 1, n1, s_n1);
+    set_edge(i, 2, p_n1, s_n1);
     if (pos_n1 > pos_n2) {
-        gain = -(distance[p_n1][n1] + distance[n1][s_n1] + distance[p_n2][n2])
-        + (distance[n1][n2] + distance[p_n2][n1] + distance[p_n1][s_n1]);
+        set_edge(i, 4, p_n2, n2);
+        set_edge(i, 6, n1, n2);
+        set_edge(i, 7, p_n2, n1);
     } else {
-        gain = -(distance[p_n1][n1] + distance[n1][s_n1] + distance[n2][s_n2])
-        + (distance[n2][n1] + distance[n1][s_n2] + distance[p_n1][s_n1]);
+        set_edge(i, 4, n2, s_n2);
+        set_edge(i, 6, n2, n1);
+        set_edge(i, 7, n1, s_n2);
     }
-    
-    dist = route->dist + (route->end - route->beg - 1) * instance->service_time + gain;
-    if(dist > instance->max_distance) {
-        valid = false;
-    }
-    
-    return new InsertionMove(ant, valid, gain, pos_n1, pos_n2, load_r1, load_r2);
 }
 
 /*
  * chooses two nodes in a route randomly, 
  * and then inverts the substring between these two non-zero nodes[n1, n2],
  * pos_n1 and pos_n2 included.
+ * 整条route反向时没有意义, 返回false
  */
-Move *NeighbourSearch::inversion(int *tour, int tour_size)
+bool NeighbourSearch::inversion(int *tour, int i)
 {
     Route *route = NULL;
+    int r = 0;
     int sz = 0;     /* route size */
     int n1, n2;   /* random node from route 1 and toure 2*/
     int pos_n1 = 0, pos_n2 = 0;
     int p_n1, s_n2;
-    double gain;
-    double **distance = instance->distance;
-    double dist;
-    bool valid = true;
     
     sz = 0;
     while (sz <= 3) {
-        route = &routes[random_route()];
+        r = random_route();
+        route = &routes[r];
         sz = route->end -route->beg + 1;
     }
     
@@ -405,7 +578,7 @@ Move *NeighbourSearch::inversion(int *tour, int tour_size)
     
     // useless
     if (pos_n2 == route->end - 1 && pos_n1 == route->beg + 1) {
-        return NULL;
+        return false;
     }
     
     n1 = tour[pos_n1];
@@ -417,14 +590,12 @@ Move *NeighbourSearch::inversion(int *tour, int tour_size)
     DEBUG(assert(n1 != n2);)
     DEBUG(assert(pos_n1 > 0 && pos_n2 > 0 && pos_n1 < pos_n2);)
     
-    gain = -(distance[p_n1][n1] + distance[n2][s_n2]) + (distance[p_n1][n2] + distance[n1][s_n2]);
-    
-    dist = route->dist + (route->end - route->beg - 1) * instance->service_time + gain;
-    if(dist > instance->max_distance) {
-        valid = false;
-    }
-    
-    return new InversionMove(ant, valid, gain, pos_n1, pos_n2);
+    set_candidate(i, INVERSION_MOVE, pos_n1, pos_n2, r, r, route->load, route->load, sz - 2, sz - 2);
+    set_edge(i, 0, p_n1, n1);
+    set_edge(i, 1, n2, s_n2);
+    set_edge(i, 2, p_n1, n2);
+    set_edge(i, 3, n1, s_n2);
+    return true;
 }
 
 
@@ -434,13 +605,13 @@ Move *NeighbourSearch::inversion(int *tour, int tour_size)
  */
 int NeighbourSearch::random_pos_in_route(Route *route)
 {
-    return (route->beg + random()%(route->end - route->beg));
+    return (route->beg + rng_int(rng, route->end - route->beg));
 }
 
 
 int NeighbourSearch::random_route(void)
 {
-    return (int)random()%(routes.size());
+    return rng_int(rng, (int)routes.size());
 }
 
 
@@ -15,28 +15,71 @@
 #include "move.h"
 #include "localSearch.h"
 
+#define BATCH_EDGES 8     /* 每个候选移动记录的边: 0,1 route1删除的边, 2,3 route1加入的边, 4~7 route2 同上 */
+
+/*
+ * 一批候选移动, structure of arrays.
+ * 采样时只记录每个移动删除/加入的边(不足的用(0,0)补齐, 其距离为0)和新的load,
+ * evaluate 在一个无分支的循环中计算所有候选的 gain、新的route距离与可行性
+ */
+struct MoveBatch {
+    int size;
+    int capacity;
+    int *from[BATCH_EDGES];
+    int *to[BATCH_EDGES];
+    MoveType *type;
+    int *pos_n1;
+    int *pos_n2;
+    int *r1;
+    int *r2;
+    int *load_r1;
+    int *load_r2;
+    double *base_r1;        /* 移动前route的距离 */
+    double *base_r2;
+    double *shared;         /* r1 == r2 时为1: route2的边也属于route1 */
+    double *limit_r1;       /* 移动后route允许的最大距离(max_distance - service time) */
+    double *limit_r2;
+    
+    /* 由 evaluate 写入 */
+    double *gain;
+    double *dist_r1;
+    double *dist_r2;
+    char *valid;
+};
+
 class NeighbourSearch {
 public:
-    NeighbourSearch(Problem *instance);
+    NeighbourSearch(Problem *instance, Rng *rng);
     ~NeighbourSearch();
     void reset_ant(AntStruct *ant);
-    Move *search(AntStruct *ant);
+    bool search(Move *move);
+    int search_batch(int n);
+    void get_move(int i, Move *move) const;
+    void apply(const Move *move);
+    
+    MoveBatch batch;            /* search_batch 的结果 */
     
 private:
     Problem *instance;
+    Rng *rng;                   /* 调用者(SA的各replica)私有的随机数流 */
     AntStruct *ant;
-    vector<Route> routes;
-    int rnd_seed;
+    vector<Route> routes;       /* ant的各route, 由 reset_ant 建立, 之后由 apply 增量更新 */
     
     
     int random_pos_in_route(Route *route);
     int random_route();
     
-    Move *exchange(int *tour, int tour_size);
-    Move *exchange_1(int *tour, int tour_size);
-    Move *insertion(int *tour, int tour_size);
-    Move *insertion_1(int *tour, int tour_size);
-    Move *inversion(int *tour, int tour_size);
+    bool sample(int i);
+    void evaluate(void);
+    bool set_candidate(int i, MoveType type, int pos_n1, int pos_n2, int r1, int r2,
+                       int load_r1, int load_r2, int size_r1, int size_r2);
+    void set_edge(int i, int k, int from, int to);
+    
+    void exchange(int *tour, int i);
+    void exchange_1(int *tour, int i);
+    void insertion(int *tour, int i);
+    void insertion_1(int *tour, int i);
+    bool inversion(int *tour, int i);
 };
 
 #endif /* neighbourSearch_h */
@@ -30,24 +30,47 @@
 #include "timer.h"
 
 
-struct ThreadInfo
-{
-    Problem *master;
-    ParallelAco *master_solver;
-    Problem *sub;
-};
-
 void *handle(void* in);
 
 
 ParallelAco::~ParallelAco()
 {
-    for (int i = 0; i < route_centers.size(); i++) {
-        delete route_centers[i]->coord;
-        delete route_centers[i];
+    delete sub_pool;
+    for (int i = 0; i < center_pool.size(); i++) {
+        delete center_pool[i]->coord;
+        delete center_pool[i];
+    }
+    for (int i = 0; i < all_subs.size(); i++) {
+        delete sub_solvers[i];
+        exit_sub_problem(all_subs[i]);
+    }
+}
+
+/*
+ * 子问题线程在整个 trial 中重复使用, 线程数为 instance->num_sub_threads
+ * (pipeline 时与 master 的 worker 线程合计不超过该try的线程数)
+ */
+void ParallelAco::init_aco()
+{
+    AntColony::init_aco();
+    
+    if (sub_pool == NULL) {
+        sub_pool = new ThreadPool(MAX(instance->num_sub_threads, 1));
     }
 }
 
+void ParallelAco::exit_aco()
+{
+    // 等待仍在后台求解的子问题, 结果仍然合并至master
+    if (subs_running) {
+        merge_sub_problems();
+    }
+    delete sub_pool;
+    sub_pool = NULL;
+    
+    AntColony::exit_aco();
+}
+
 /*
  * compute the center of gravity for best so far solution's each route
  */
@@ -55,10 +78,15 @@ void ParallelAco::get_solution_centers(AntStruct *ant)
 {
     int route_beg = 0;
     RouteCenter * center;
-    route_centers.clear();   // 清空前一次迭代的数据
+    route_centers.clear();   // 清空前一次迭代的数据, RouteCenter 由 center_pool 重复使用
     for (int i = 1; i < ant->tour_size; i++) {
         if (ant->tour[i] == 0) {
-            center = new RouteCenter();
+            if (route_centers.size() == center_pool.size()) {
+                center = new RouteCenter();
+                center->coord = new Point();
+                center_pool.push_back(center);
+            }
+            center = center_pool[route_centers.size()];
             center->beg = route_beg;
             center->end = i;
             route_centers.push_back(center);
@@ -110,7 +138,7 @@ void ParallelAco::decompose_problem(AntStruct *ant)
     Problem *master = instance;
     
     // random start pos from [0, route_num)
-    int rnd_beg = (int)(ran01(&instance->rnd_seed) * (route_centers.size() - 1));
+    int rnd_beg = (int)(rng_uniform(&instance->rng) * (route_centers.size() - 1));
     /* 一个子问题包含的routes数目 */
     int sub_problem_route_num = (int)(route_centers.size() / master->num_subs);
     /* 
@@ -119,31 +147,32 @@ void ParallelAco::decompose_problem(AntStruct *ant)
      * 每个子问题分配的子routes数量为: sub_problem_route_num 或 sub_problem_route_num + 1
      */
     int remainder = route_centers.size() % master->num_subs;
+    int num_subs = 0;
     
-    vector< vector<RouteCenter *> > sub_problem_routes;
-    vector<RouteCenter *> tmp;
+    if ((int)sub_problem_routes.size() < master->num_subs) {
+        sub_problem_routes.resize(master->num_subs);
+    }
+    for (int i = 0; i < sub_problem_routes.size(); i++) {
+        sub_problem_routes[i].clear();
+    }
 
     sort_route_centers();
     
-    // 增加拆分的随机性
-    for(int i = 0; i < rnd_beg; i++) {
-        route_centers.insert(route_centers.begin(), *(route_centers.end()-1));
-        route_centers.pop_back();
-    }
+    // 增加拆分的随机性: 将末尾 rnd_beg 个route移到开头
+    rotate(route_centers.begin(), route_centers.end() - rnd_beg, route_centers.end());
     
     // 计算子问题分配的routes
     for (int i = 0; i < route_centers.size(); i++) {
-        tmp.push_back(route_centers[i]);
-        if (tmp.size() == sub_problem_route_num + (remainder > 0)) {
+        sub_problem_routes[num_subs].push_back(route_centers[i]);
+        if (sub_problem_routes[num_subs].size() == sub_problem_route_num + (remainder > 0)) {
             if (remainder > 0) {
                 remainder--;
             }
-            sub_problem_routes.push_back(tmp);
-            tmp.clear();
+            num_subs++;
         }
     }
     
-    build_sub_problems(ant, sub_problem_routes);
+    build_sub_problems(ant, num_subs);
     
     TRACE(print_problem_decompositon(subs);)
 //    print_problem_decompositon(subs);
@@ -151,20 +180,25 @@ void ParallelAco::decompose_problem(AntStruct *ant)
 
 /*
  * 将主问题分解成多个独立的子问题，并初始化子问题结构体
+ * 子问题及其蚁群在外循环之间重复使用, 只在第一次出现第p个子问题时分配
  */
-void ParallelAco::build_sub_problems(AntStruct *ant, const vector< vector<RouteCenter *> >& sub_problem_routes)
+void ParallelAco::build_sub_problems(AntStruct *ant, int num_subs)
 {
     
     Problem *sub, *master = instance;
     int *tour = ant->tour;
-    vector<RouteCenter *> routes;
     double sub_best_length;
     int i, j, k, t;
     
-    for (int p = 0; p < sub_problem_routes.size(); p++)
+    subs.clear();
+    for (int p = 0; p < num_subs; p++)
     {
-        sub = new Problem(p+1);         // 子问题从1开始编号!!
-        routes = sub_problem_routes[p];
+        if (p == all_subs.size()) {
+            all_subs.push_back(new Problem(p+1));         // 子问题从1开始编号!!
+            sub_solvers.push_back(NULL);
+        }
+        sub = all_subs[p];
+        const vector<RouteCenter *>& routes = sub_problem_routes[p];
         sub_best_length = 0;
         
         /*
@@ -172,6 +206,7 @@ void ParallelAco::build_sub_problems(AntStruct *ant, const vector< vector<RouteC
          * i.e. nodes = {0,3,12,5,8} 重新编号后: {0,1,2,3,4}
          * 因此需要额外的数组记录编号前后的映射关系
          */
+        sub->real_nodes.clear();
         sub->real_nodes.push_back(0);   // the depot
         sub->num_node = 1;
         for (i = 0; i < routes.size(); i++) {
@@ -183,6 +218,11 @@ void ParallelAco::build_sub_problems(AntStruct *ant, const vector< vector<RouteC
         
         // 获取子问题的num_node之后便可以初始化
         init_sub_problem(master, sub);
+        if (sub_solvers[p] == NULL) {
+            sub_solvers[p] = new AntColony(sub);
+        } else {
+            sub_solvers[p]->sync_instance();
+        }
         
         /*
          * 由主问题计算出来的解作为子问题当前最优解
@@ -194,7 +234,7 @@ void ParallelAco::build_sub_problems(AntStruct *ant, const vector< vector<RouteC
         t = 0;
         for (i = 0; i < routes.size(); i++) {
             for (j = routes[i]->beg; j < routes[i]->end; j++) {
-                sub_best_length += master->distance[tour[j]][tour[j+1]];
+                sub_best_length += master->distance(tour[j], tour[j+1]);
                 if (tour[j] == 0) {
                     sub->best_so_far_ant->tour[k++] = 0;
                 } else {
@@ -210,6 +250,9 @@ void ParallelAco::build_sub_problems(AntStruct *ant, const vector< vector<RouteC
         sub->best_so_far_ant->tour_length = sub_best_length;
         sub->best_so_far_ant->tour_size = k;
         
+        // 子问题线程不再读取master的信息素, 因此在此处初始化 best_pheromone
+        init_sub_best_pheromone(master, sub);
+        
         //debug
 //        print_solution(sub, sub->best_so_far_ant->tour, sub->best_so_far_ant->tour_size);
         
@@ -227,8 +270,6 @@ void ParallelAco::init_sub_pheromone(AntColony *sub_solver, Problem *master, Pro
 {
     TRACE( printf("init sub-problem %d pheromone...\n", sub->pid);)
     
-    int i, j, ri, rj;
-    double ratio = 1.0 * sub->best_so_far_ant->tour_length / master->best_so_far_ant->tour_length;
     /*
      * 1)子问题从主问题那里获取初始信息素
      */
@@ -252,35 +293,39 @@ void ParallelAco::init_sub_pheromone(AntColony *sub_solver, Problem *master, Pro
     // 为第一次迭代做的设置
     double trail_0 = 0.5;
     sub_solver->init_pheromone_trails(trail_0);
-    sub_solver->compute_total_information();
     
     // 第一次迭代用于设置一个合适的 pheromone init trail
     sub_solver->construct_solutions();
-    if (ls_flag) {
-        sub_solver->local_search->do_local_search();
+    if (config.ls_flag) {
+        sub_solver->do_local_search();
     }
     sub_solver->update_statistics();
-    trail_0 =  1.0 / ((rho) * sub->best_so_far_ant->tour_length);
+    trail_0 =  1.0 / ((config.rho) * sub->best_so_far_ant->tour_length);
     sub_solver->init_pheromone_trails(trail_0);
-    if(ls_flag) {
-        sub_solver->compute_nn_list_total_information();
-    } else {
-        sub_solver->compute_total_information();
-    }
     sub->iteration++;
     /***** end of (2) *****/
     
-    // !!!需要初始化 best_pheromone
+//    print_total_info(sub);
+//    print_pheromone(sub);
+}
+
+/*
+ * !!!需要初始化 best_pheromone: 由主问题信息素按比例转换.
+ * 在主线程中调用(分解问题时), 子问题线程运行期间不会读取master的信息素
+ */
+void ParallelAco::init_sub_best_pheromone(Problem *master, Problem *sub)
+{
+    int i, c, ri, rj;
+    ArcLayout *arcs = &sub->arcs;
+    double ratio = 1.0 * sub->best_so_far_ant->tour_length / master->best_so_far_ant->tour_length;
+    
     for(i = 0; i < sub->num_node; i++) {
         ri = sub->real_nodes[i];
-        for (j = 0; j < sub->num_node; j++) {
-            rj = sub->real_nodes[j];
-            sub->best_pheromone[i][j] = master->pheromone[ri][rj] / ratio;
+        for (c = 0; c < arcs->width; c++) {
+            rj = sub->real_nodes[arcs->node(i, c)];
+            sub->best_pheromone[i * arcs->width + c] = master->arcs.value(master->pheromone, ri, rj) / ratio;
         }
     }
-    
-//    print_total_info(sub);
-//    print_pheromone(sub);
 }
 
 
@@ -295,11 +340,9 @@ void ParallelAco::update_sub_best_pheromone(Problem *sub)
 {
     TRACE(printf("update sub best pheromone. (pid,iter)=(%d,%ld)\n", sub->pid, sub->iteration);)
     
-    int i, j;
-    for(i = 0; i < sub->num_node; i++) {
-        for (j = 0; j < sub->num_node; j++) {
-            sub->best_pheromone[i][j] = sub->pheromone[i][j];
-        }
+    int s;
+    for(s = 0; s < sub->arcs.size; s++) {
+        sub->best_pheromone[s] = sub->pheromone[s];
     }
 }
 
@@ -311,7 +354,8 @@ void ParallelAco::update_sub_best_pheromone(Problem *sub)
 void ParallelAco::update_subs_to_master(Problem *master, const vector<Problem *> &subs)
 {
     Problem *sub;
-    int i, j,h, rj, rh, k;
+    int i, j, c, rj, rh, k, s;
+    ArcLayout *arcs;
     int *sub_tour, *master_tour;
     int sub_sz;
     double ratio;
@@ -339,20 +383,21 @@ void ParallelAco::update_subs_to_master(Problem *master, const vector<Problem *>
         sub_best_length = sub->best_so_far_ant->tour_length;
         ratio = 1.0 * sub_best_length / master_best_length;
         
+        arcs = &sub->arcs;
         for(j = 0; j < sub->num_node; j++) {
             rj = sub->real_nodes[j];
-            for (h = 0; h < sub->num_node; h++) {
-                rh = sub->real_nodes[h];
-                master->pheromone[rj][rh] += 0.1 * sub->best_pheromone[j][h] * ratio;
+            for (c = 0; c < arcs->width; c++) {
+                rh = sub->real_nodes[arcs->node(j, c)];
+                s = master->arcs.slot(rj, rh);
+                if (s < 0) {
+                    continue;   /* master 不保存该弧 */
+                }
+                master->pheromone[s] += 0.1 * sub->best_pheromone[j * arcs->width + c] * ratio;
+                // 更新完信息素，一定需要立即计算 total_info
+                update_total_information(s);
             }
         }
     }
-    // 更新完信息素，一定需要立即计算 total_info
-    if (ls_flag) {
-        compute_nn_list_total_information();
-    } else {
-        compute_total_information();
-    }
     
     /*
      * 2)更新主问题最优解. 将子问题所有解相连接就是主问题最优解
@@ -376,7 +421,7 @@ void ParallelAco::update_subs_to_master(Problem *master, const vector<Problem *>
     DEBUG(assert(check_solution(master, master_tour, k));)
     
     // 记录-report
-    master->best_so_far_time = elapsed_time(REAL);
+    master->best_so_far_time = elapsed_run_time(master);
     write_best_so_far_report(master);
     
 //    print_solution(master, master_tour, k);
@@ -394,10 +439,24 @@ void ParallelAco::run_aco_iteration()
     Problem *master = instance;
     
     //1)computer master problem
-    for (i = 0; i < g_master_problem_iteration_num; i++) {
+    for (i = 0; i < instance->config.master_iteration_num; i++) {
         this->AntColony::run_aco_iteration();
     }
     
+    // pipeline: 子问题仍在后台求解时master继续迭代, 全部完成后合并(safe point).
+    // 这些迭代与main中的迭代一样计数; 满足终止条件时直接返回, 子问题由 exit_aco 合并
+    if (subs_running) {
+        while (sub_pool->busy()) {
+            instance->iteration++;
+            if (termination_condition(instance)) {
+                instance->iteration--;      /* main 返回后会再加1 */
+                return;
+            }
+            this->AntColony::run_aco_iteration();
+        }
+        merge_sub_problems();
+    }
+    
     // 2) compute the center of gravity for each route
     get_solution_centers(master->best_so_far_ant);
     
@@ -405,33 +464,41 @@ void ParallelAco::run_aco_iteration()
     decompose_problem(master->best_so_far_ant);
     
     // 4)子问题递归
-    pthread_t tids[subs.size()];
-    ThreadInfo infos[subs.size()], *info;
-    for (i = 0; i < subs.size(); i++) {
-        info = &infos[i];
-        info->master = master;
-        info->master_solver = this;
-        info->sub = subs[i];
-        
-        int ret = pthread_create(&tids[i], NULL, handle, (void *)info);
-        if(ret) {
-            printf("create pthread error!\n");
-            exit(EXIT_FAILURE);
-        }
-    }
+    solve_sub_problems();
     
-    for (i = 0; i < subs.size(); i++) {
-        pthread_join(tids[i], NULL);
+    // 5)更新master, pipeline 模式下推迟到下一次外循环
+    if (!instance->config.pipeline_flag) {
+        merge_sub_problems();
     }
+}
+
+/*
+ * 将子问题提交至线程池, 不等待完成
+ */
+void ParallelAco::solve_sub_problems(void)
+{
+    ThreadInfo *info;
     
-    // 5)更新master
-    update_subs_to_master(master, subs);
-    
-    // 6)清空本次迭代子问题数据
+    sub_infos.resize(subs.size());
     for (int i = 0; i < subs.size(); i++) {
-        exit_sub_problem(subs[i]);
+        info = &sub_infos[i];
+        info->master = instance;
+        info->master_solver = this;
+        info->sub = subs[i];
+        info->sub_solver = sub_solvers[i];
+        sub_pool->submit(handle, (void *)info);
     }
-    subs.clear();
+    subs_running = true;
+}
+
+/*
+ * 等待所有子问题完成, 并将结果更新至master
+ */
+void ParallelAco::merge_sub_problems(void)
+{
+    sub_pool->wait();
+    subs_running = false;
+    update_subs_to_master(instance, subs);
 }
 
 
@@ -447,15 +514,15 @@ void *handle(void* in)
     master = info->master;
     sub = info->sub;
     master_solver = info->master_solver;
-    sub_solver = new AntColony(sub);
+    sub_solver = info->sub_solver;
     
     sub_best_length = sub->best_so_far_ant->tour_length;
     
     // 根据主问题信息素初始化子问题信息素
     master_solver->init_sub_pheromone(sub_solver, master, sub);
     
-    // 子问题递归
-    for (j = 0; j < sub->max_iteration; j++)
+    // 子问题递归, 到达截止时间后停止
+    for (j = 0; j < sub->max_iteration && !deadline_expired(sub->deadline); j++)
     {
         sub_solver->AntColony::run_aco_iteration();
         
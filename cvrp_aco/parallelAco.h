@@ -20,27 +20,52 @@
 #include <vector>
 #include "problem.h"
 #include "antColony.h"
+#include "threadPool.h"
 
 using namespace std;
 
+class ParallelAco;
+
+struct ThreadInfo
+{
+    Problem *master;
+    ParallelAco *master_solver;
+    Problem *sub;
+    AntColony *sub_solver;
+};
+
 class ParallelAco: public AntColony {
 public:
-    ParallelAco(Problem *inst):AntColony(inst){}
+    ParallelAco(Problem *inst):AntColony(inst), sub_pool(NULL), subs_running(false){}
     virtual ~ParallelAco();
     
+    virtual void init_aco(void);
+    virtual void exit_aco(void);
     virtual void run_aco_iteration(void);
     void init_sub_pheromone(AntColony *sub_solver, Problem *master, Problem *sub);
+    void init_sub_best_pheromone(Problem *master, Problem *sub);
     static void update_sub_best_pheromone(Problem *sub);
     void update_subs_to_master(Problem *master, const vector<Problem *> &subs);
     
 private:
-    vector<Problem *> subs;            /* 多个子问题 */
+    vector<Problem *> subs;            /* 本次外循环的子问题, 取自 all_subs */
     vector<RouteCenter *> route_centers;    /* each route's center info */
+    ThreadPool *sub_pool;              /* 求解子问题的线程, init_aco 时创建 */
+    vector<ThreadInfo> sub_infos;      /* 子问题线程参数, 每次外循环重复使用 */
+    bool subs_running;                 /* pipeline 模式下, 上一次分解的子问题正在后台求解 */
+    
+    /* 以下缓冲区只增不减, 在所有外循环中重复使用 */
+    vector<Problem *> all_subs;             /* 已分配的子问题 */
+    vector<AntColony *> sub_solvers;        /* all_subs 对应的蚁群 */
+    vector<RouteCenter *> center_pool;      /* 已分配的 RouteCenter */
+    vector< vector<RouteCenter *> > sub_problem_routes;   /* 每个子问题分配的routes */
     
     void get_solution_centers(AntStruct *ant);
     void sort_route_centers();
     void decompose_problem(AntStruct *best_so_far_ant);
-    void build_sub_problems(AntStruct *ant, const vector< vector<RouteCenter *> >& sub_problem_routes);
+    void build_sub_problems(AntStruct *ant, int num_subs);
+    void solve_sub_problems(void);
+    void merge_sub_problems(void);
 };
 
 #endif /* parallelAco_h */
@@ -0,0 +1,157 @@
+///*********************************
+//
+// Ant Colony Optimization algorithms RAS for CVRP
+//
+// Created by 孙晓奇 on 2016/10/19.
+// Copyright © 2016年 xiaoqi.sxq. All rights reserved.
+//
+// Program's name: acovrp
+// Purpose: parallel tempering (replica exchange) for the SA stage
+//
+// email: sunxq1991@gmail.com
+//
+// *********************************/
+
+#include <math.h>
+
+#include "parallelTempering.h"
+#include "threadPool.h"
+#include "utilities.h"
+#include "timer.h"
+
+ParallelTempering::ParallelTempering(Problem *instance, AntColony *ant_colony, int n_replicas, double t0,
+                                     double ladder_ratio, double alpha, int epoch_length, int terminal_ratio)
+{
+    this->instance = instance;
+    this->ant_colony = ant_colony;
+    this->n_replicas = n_replicas;
+    this->t0 = t0;
+    this->terminal_ratio = terminal_ratio;
+    
+    // replica i 从第i个温度开始, 信息素由 update_best 统一更新
+    replicas = new SimulatedAnnealing *[n_replicas];
+    ladder = new int[n_replicas];
+    for (int i = 0; i < n_replicas; i++) {
+        replicas[i] = new SimulatedAnnealing(instance, NULL, t0 * pow(ladder_ratio, i),
+                                             alpha, epoch_length, terminal_ratio);
+        ladder[i] = i;
+    }
+    
+    best_replica = 0;
+    best_length = instance->best_so_far_ant->tour_length;
+    
+    exchange_cnt = 0;
+    swap_cnt = 0;
+}
+
+ParallelTempering::~ParallelTempering()
+{
+    for (int i = 0; i < n_replicas; i++) {
+        delete replicas[i];
+    }
+    delete[] replicas;
+    delete[] ladder;
+}
+
+void ParallelTempering::run(void)
+{
+    int parity = 0;
+    
+    printf("\n----- Start PT. pid: %d replicas: %d length: %f iter: %d time: %f-----\n",
+           instance->pid, n_replicas, best_length, instance->iteration, elapsed_run_time(instance));
+    
+    while (replicas[ladder[0]]->get_temperature() > (t0 / terminal_ratio)
+           && !deadline_expired(instance->deadline)) {
+        run_epoch();
+        update_best();
+        exchange(parity);
+        parity = 1 - parity;
+    }
+    
+    replicas[best_replica]->commit_best();
+    
+    printf("----- End PT. pid: %d length: %f iter: %d swaps: %d/%d time: %f-----\n",
+           instance->pid, best_length, instance->iteration, swap_cnt, exchange_cnt, elapsed_run_time(instance));
+}
+
+/*
+ * 线程函数: replica 以当前温度退火一个epoch
+ */
+void *ParallelTempering::epoch_handle(void *in)
+{
+    SimulatedAnnealing *replica = (SimulatedAnnealing *)in;
+    
+    replica->run_epoch();
+    return NULL;
+}
+
+/*
+ * 所有replica各退火一个epoch; replica[0]在调用线程中执行, 其余交给蚁群的线程池
+ */
+void ParallelTempering::run_epoch(void)
+{
+    ThreadPool *pool = ant_colony->pool;
+    int i;
+    
+    for (i = 1; i < n_replicas; i++) {
+        if (pool != NULL) {
+            pool->submit(epoch_handle, (void *)replicas[i]);
+        } else {
+            epoch_handle((void *)replicas[i]);
+        }
+    }
+    
+    epoch_handle((void *)replicas[0]);
+    
+    if (pool != NULL) {
+        pool->wait();
+    }
+}
+
+/*
+ * 相邻温度的replica(ladder[k], ladder[k+1]), k = parity, parity+2, ...
+ * 以概率 min(1, exp((1/t_k - 1/t_k+1) * (len_k - len_k+1))) 交换温度.
+ * parity 交替取0和1, 使温度可以沿整个阶梯移动
+ */
+void ParallelTempering::exchange(int parity)
+{
+    SimulatedAnnealing *cold, *hot;
+    double t_cold, t_hot, delta;
+    int k, tmp;
+    
+    for (k = parity; k + 1 < n_replicas; k += 2) {
+        cold = replicas[ladder[k]];
+        hot = replicas[ladder[k+1]];
+        t_cold = cold->get_temperature();
+        t_hot = hot->get_temperature();
+        delta = (1 / t_cold - 1 / t_hot) * (cold->current_length() - hot->current_length());
+        
+        exchange_cnt++;
+        if (delta >= 0 || rng_uniform(&instance->rng) < exp(delta)) {
+            cold->set_temperature(t_hot);
+            hot->set_temperature(t_cold);
+            tmp = ladder[k];
+            ladder[k] = ladder[k+1];
+            ladder[k+1] = tmp;
+            swap_cnt++;
+        }
+    }
+}
+
+/*
+ * 记录各replica找到的最优解, 有更好的解时更新信息素(与单个SA一致).
+ * 只在调用线程中、各replica都空闲时执行
+ */
+void ParallelTempering::update_best(void)
+{
+    AntStruct *best_ant;
+    
+    for (int i = 0; i < n_replicas; i++) {
+        best_ant = replicas[i]->get_best_ant();
+        if (best_ant->tour_length - best_length < -EPSILON) {
+            best_length = best_ant->tour_length;
+            best_replica = i;
+            ant_colony->global_update_pheromone_weighted(best_ant, 2 * instance->config.ras_ranks);
+        }
+    }
+}
@@ -0,0 +1,57 @@
+/*********************************
+
+ Ant Colony Optimization algorithms RAS for CVRP
+
+ Created by 孙晓奇 on 2016/10/19.
+ Copyright © 2016年 xiaoqi.sxq. All rights reserved.
+
+ Program's name: acovrp
+ Purpose: parallel tempering (replica exchange) for the SA stage
+
+ email: sunxq1991@gmail.com
+
+ *********************************/
+
+#ifndef parallelTempering_h
+#define parallelTempering_h
+
+#include <stdio.h>
+#include "problem.h"
+#include "antColony.h"
+#include "simulatedAnnealing.h"
+
+/*
+ * 多个replica从当前最优解出发, 在温度阶梯 t0, t0*ratio, t0*ratio^2, ... 上同时退火,
+ * 每个epoch由蚁群的线程池并行执行, 各replica降温一次后, 相邻温度的replica按Metropolis准则交换温度.
+ * 最低温度降到 t0/terminal_ratio 时结束, epoch数与单个SA相同.
+ */
+class ParallelTempering {
+public:
+    ParallelTempering(Problem *instance, AntColony *ant_colony, int n_replicas, double t0,
+                      double ladder_ratio, double alpha, int epoch_length, int terminal_ratio);
+    ~ParallelTempering();
+    void run(void);
+
+private:
+    Problem *instance;
+    AntColony *ant_colony;
+    int n_replicas;
+    SimulatedAnnealing **replicas;
+    int *ladder;                /* ladder[k]: 温度第k低的replica */
+    double t0;
+    int terminal_ratio;
+    int best_replica;           /* 找到最优解的replica */
+    double best_length;
+
+    // 用于统计
+    int exchange_cnt;
+    int swap_cnt;
+
+    void run_epoch(void);
+    void exchange(int parity);
+    void update_best(void);
+
+    static void *epoch_handle(void *in);
+};
+
+#endif /* parallelTempering_h */
@@ -15,6 +15,8 @@
 #include <stdio.h>
 #include <time.h>
 #include <math.h>
+#include <unistd.h>
+#include <string.h>
 
 #include "problem.h"
 #include "io.h"
@@ -22,21 +24,18 @@
 #include "vrpHelper.h"
 #include "timer.h"
 
-
-/**** 用于parallel aco参数 ***/
-int g_master_problem_iteration_num;   /* 每次外循环，主问题蚁群的迭代的次数 */
-int g_sub_problem_iteration_num;      /* 每次外循环，子问题蚁群的迭代次数 */
-bool sa_flag = true;                        /* 是否使用sa */
-
-double rho;           /* parameter for evaporation */
-double alpha;         /* importance of trail */
-double beta;          /* importance of heuristic evaluate */
-int ras_ranks;   /* additional parameter for rank-based version of ant system */
-
 /* ------------------------------------------------------------------------ */
 
 void set_default_parameters (Problem *instance);
+void inherit_parameters (Problem *master, Problem *instance);
+void allocate_problem (Problem *instance);
+void allocate_arc_vectors (Problem *instance);
+void free_problem (Problem *instance);
+void compute_problem (Problem *instance);
+void init_arc_layout (Problem *instance);
+void init_arc_columns (Problem *instance);
 void allocate_ants (Problem *instance);
+void init_ants (Problem *instance);
 
 /*
  * 初始化问题
@@ -44,68 +43,88 @@ void allocate_ants (Problem *instance);
 void init_problem(Problem *instance)
 {
     set_default_parameters(instance);
+    if (instance->rnd_seed == 0) {
+        instance->rnd_seed = (int) time(NULL);
+    }
+    rng_seed(&instance->rng, instance->rnd_seed);
     
     // 为 problem 实例的成员分配内存
-    // 只有主问题需要计算distance矩阵
-    if (instance->pid == 0) {
-        instance->distance = compute_distances(instance);
+    instance->capacity = instance->num_node;
+    instance->distance.rows = compute_distances(instance);
+    instance->distance.map = NULL;
+    allocate_problem(instance);
+    compute_nn_lists(instance);
+    compute_problem(instance);
+    
+    if((instance->sub_index = (int *)malloc(sizeof(int) * instance->num_node)) == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < instance->num_node; i++) {
+        instance->sub_index[i] = -1;
     }
-    instance->nn_list = compute_nn_lists(instance);
-    instance->pheromone = generate_double_matrix(instance->num_node, instance->num_node);
-    instance->total_info = generate_double_matrix(instance->num_node, instance->num_node );
-    allocate_ants(instance);
 }
 
 void exit_problem(Problem *instance)
 {
-    // 释放内存
-    free( instance->distance );
-    free(instance->nodeptr);
-    free( instance->nn_list );
-    free( instance->pheromone );
-    free( instance->total_info );
-    for (int i = 0 ; i < instance->n_ants ; i++ ) {
-        free( instance->ants[i].tour );
-        free( instance->ants[i].visited );
-        free( instance->ants[i].candidate );
+    // 释放内存, 子问题与岛的距离矩阵属于主问题
+    if (instance->pid == 0) {
+        free( instance->distance.rows );
     }
-    free( instance->ants );
-    free( instance->best_so_far_ant->tour );
-    free( instance->best_so_far_ant->visited );
-    free( instance->prob_of_selection );
-    free(instance);
+    free(instance->nodeptr);
+    free(instance->sub_index);
+    free_problem(instance);
+    delete instance;
 }
 
 
 /*
  * 初始子问题
- * Note: 子问题的distance可以从主问题直接赋值，减少重复计算
+ * Note: 子问题的distance直接使用主问题的矩阵(见DistanceMatrix), nn_list由主问题的nn_list筛选得到
+ * 子问题在每次外循环中重复使用, 缓冲区按出现过的最大num_node(capacity)分配,
+ * 只有num_node超过capacity时才重新分配, 因此稳定之后不再申请内存.
+ * 弧向量例外: dense/sparse由num_node决定, 较小的dense子问题可能比较大的sparse子问题需要更多的弧,
+ * 因此弧数超过arc_capacity时单独重新分配弧向量
  */
 void init_sub_problem(Problem *master, Problem *sub)
 {
-    double **sub_dis;
-    int ri, rj;
+    int ri;
     Point *nodeptr, *m_node;
     
-    // 初始化 sub-problem distance矩阵
-    if((sub_dis = (double **)malloc(sizeof(double) * sub->num_node * sub->num_node +
-                                      sizeof(double *) * sub->num_node)) == NULL) {
-        exit(EXIT_FAILURE);
-    }
-    for (int i = 0; i < sub->num_node; i++ ) {
-        sub_dis[i] = (double *)(sub_dis + sub->num_node) + i * sub->num_node;
-        ri = sub->real_nodes[i];
-        for (int j = 0; j < sub->num_node; j++ ) {
-            rj = sub->real_nodes[j];
-            sub_dis[i][j] = master->distance[ri][rj];
+    set_default_parameters(sub);
+    inherit_parameters(master, sub);
+    rng_split(&master->rng, &sub->rng);
+    
+    if (sub->num_node > sub->capacity) {
+        if (sub->capacity > 0) {
+            free(sub->nodeptr);
+            free(sub->best_pheromone);
+            free_problem(sub);
+        }
+        sub->capacity = sub->num_node;
+        if((sub->nodeptr = (Point *)malloc(sizeof(Point) * sub->capacity)) == NULL) {
+            exit(EXIT_FAILURE);
+        }
+        allocate_problem(sub);
+        // sub 需要额外的结构存储当前最优解所对应的信息素
+        sub->best_pheromone = generate_arc_vector(sub);
+    } else {
+        init_arc_layout(sub);
+        if (sub->arcs.size > sub->arc_capacity) {
+            free(sub->heuristic);
+            free(sub->pheromone);
+            free(sub->total_info);
+            free(sub->best_pheromone);
+            allocate_arc_vectors(sub);
+            sub->best_pheromone = generate_arc_vector(sub);
         }
     }
-    sub->distance = sub_dis;
+    
+    // sub-problem distance矩阵: 通过real_nodes访问主问题矩阵, 不复制
+    sub->distance.rows = master->distance.rows;
+    sub->distance.map = &sub->real_nodes[0];
     
     // 初始化nodeptr
-    if((nodeptr = (Point *)malloc(sizeof(Point) * sub->num_node)) == NULL) {
-        exit(EXIT_FAILURE);
-    }
+    nodeptr = sub->nodeptr;
     for (int i = 0 ; i < sub->num_node ; i++ ) {
         ri = sub->real_nodes[i];
         m_node = &master->nodeptr[ri];
@@ -113,15 +132,15 @@ void init_sub_problem(Problem *master, Problem *sub)
         nodeptr[i].y = m_node->y;
         nodeptr[i].demand = m_node->demand;
     }
-    sub->nodeptr = nodeptr;
     
-    // sub 需要额外的结构存储当前最优解所对应的信息素
-    sub->best_pheromone = generate_double_matrix(sub->num_node, sub->num_node);
 //    print_distance(sub);
     
-    init_problem(sub);
+    compute_sub_nn_lists(master, sub);
+    compute_problem(sub);
     
-    sub->max_iteration = g_sub_problem_iteration_num;
+    sub->max_iteration = master->config.sub_iteration_num;
+    /* 子问题本身已经在独立线程中求解 */
+    sub->num_threads = 1;
     sub->dis_type = master->dis_type;
     sub->vehicle_capacity = master->vehicle_capacity;
     
@@ -129,10 +148,212 @@ void init_sub_problem(Problem *master, Problem *sub)
     sub->service_time = master->service_time;
 }
 
+/*
+ * 初始化岛(island model)问题: 与主问题是同一个实例, 共享距离矩阵,
+ * 但拥有独立的信息素、蚂蚁和随机数种子
+ */
+void init_island_problem(Problem *master, Problem *island)
+{
+    strcpy(island->name, master->name);
+    strcpy(island->edge_weight_type, master->edge_weight_type);
+    island->dis_type = master->dis_type;
+    island->optimum = master->optimum;
+    island->num_node = master->num_node;
+    island->vehicle_capacity = master->vehicle_capacity;
+    island->max_distance = master->max_distance;
+    island->service_time = master->service_time;
+    
+    set_default_parameters(island);
+    inherit_parameters(master, island);
+    
+    island->capacity = island->num_node;
+    island->distance = master->distance;
+    if((island->nodeptr = (Point *)malloc(sizeof(Point) * island->num_node)) == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    memcpy(island->nodeptr, master->nodeptr, sizeof(Point) * island->num_node);
+    
+    allocate_problem(island);
+    memcpy(island->nn_list + island->capacity, master->nn_list + master->capacity,
+           sizeof(int) * island->num_node * nn_list_depth(island));
+    for (int i = 0; i < island->num_node; i++) {
+        island->nn_list[i] = (int *)(island->nn_list + island->capacity) + i * nn_list_depth(island);
+    }
+    compute_problem(island);
+    
+    /* 每个岛在一个线程中求解, 随机数流由主问题派生以保证各岛不同 */
+    island->num_threads = 1;
+    island->rnd_seed = master->rnd_seed;
+    rng_split(&master->rng, &island->rng);
+    island->max_iteration = master->max_iteration;
+}
+
 void exit_sub_problem(Problem *sub)
 {
-    free(sub->best_pheromone);
-    exit_problem(sub);
+    if (sub->capacity > 0) {
+        free(sub->best_pheromone);
+        exit_problem(sub);
+    } else {
+        delete sub;
+    }
+}
+
+/*
+ FUNCTION:       allocate the buffers of the instance for capacity nodes
+ INPUT:          problem instance, the parameters have to be set up for
+                 num_node == capacity
+ OUTPUT:         none
+ (SIDE)EFFECTS:  sets up the arc layout, the buffers are large enough for any
+                 num_node <= capacity except the arc vectors, which hold
+                 arc_capacity arcs
+ */
+void allocate_problem (Problem *instance)
+{
+    int capacity = instance->capacity;
+    
+    if((instance->nn_list = (int **)malloc(sizeof(int) * capacity * nn_list_depth(instance)
+                                           + sizeof(int *) * capacity)) == NULL){
+        exit(EXIT_FAILURE);
+    }
+    if((instance->demand = (int *)malloc(sizeof(int) * capacity)) == NULL){
+        exit(EXIT_FAILURE);
+    }
+    if((instance->demand_order = (int *)malloc(sizeof(int) * capacity)) == NULL){
+        exit(EXIT_FAILURE);
+    }
+    /* 布局需要 nn_list 指针, 必须在 nn_list 分配之后 */
+    init_arc_layout(instance);
+    /* 行指针, sparse 时末尾还有一个 0..width-1 的数组 */
+    if ((instance->arcs.nn_col = (int **)malloc(sizeof(int *) * capacity
+                                                + sizeof(int) * instance->arcs.width)) == NULL) {
+        printf("Out of memory, exit.");
+        exit(1);
+    }
+    allocate_arc_vectors(instance);
+    if (instance->config.alias_flag) {
+        instance->alias_prob = (real_t *)malloc(sizeof(real_t) * capacity * instance->nn_ants);
+        instance->alias_index = (int *)malloc(sizeof(int) * capacity * instance->nn_ants);
+        if (instance->alias_prob == NULL || instance->alias_index == NULL) {
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        instance->alias_prob = NULL;
+        instance->alias_index = NULL;
+    }
+    allocate_ants(instance);
+}
+
+/*
+ FUNCTION:       allocate heuristic, pheromone and total_info for the current arc layout
+ INPUT:          problem instance, the arc layout has to be set up
+ OUTPUT:         none
+ (SIDE)EFFECTS:  arc_capacity is set to the number of arcs of the layout
+ */
+void allocate_arc_vectors (Problem *instance)
+{
+    instance->heuristic = generate_arc_vector(instance);
+    instance->pheromone = generate_arc_vector(instance);
+    instance->total_info = generate_arc_vector(instance);
+    instance->arc_capacity = instance->arcs.size;
+}
+
+void free_problem (Problem *instance)
+{
+    free( instance->heuristic );
+    free( instance->nn_list );
+    free( instance->demand );
+    free( instance->demand_order );
+    free( instance->arcs.nn_col );
+    free( instance->pheromone );
+    free( instance->total_info );
+    free( instance->alias_prob );
+    free( instance->alias_index );
+    for (int i = 0 ; i < instance->capacity ; i++ ) {
+        free( instance->ants[i].tour );
+        free( instance->ants[i].unvisited );
+        free( instance->ants[i].unvisited_pos );
+    }
+    free( instance->ants );
+    free( instance->best_so_far_ant->tour );
+    free( instance->best_so_far_ant );
+}
+
+/*
+ FUNCTION:       compute the data derived from the distances and demands
+ INPUT:          problem instance, distance, nodeptr and nn_list have to be filled
+ OUTPUT:         none
+ */
+void compute_problem (Problem *instance)
+{
+    compute_demand_order(instance);
+    init_arc_layout(instance);
+    init_arc_columns(instance);
+    compute_heuristic(instance);
+    init_ants(instance);
+}
+
+/*
+ FUNCTION:       set up the layout shared by pheromone, total_info and heuristic
+ INPUT:          problem instance
+ OUTPUT:         none
+ (SIDE)EFFECTS:  dense layout keeps all arcs, sparse layout keeps only the
+                 nn_ants nearest neighbour arcs of each node
+ */
+void init_arc_layout (Problem *instance)
+{
+    ArcLayout *arcs = &instance->arcs;
+    int num_node = instance->num_node;
+    
+    arcs->sparse = instance->config.sparse_threshold > 0 && num_node > instance->config.sparse_threshold;
+    arcs->num_node = num_node;
+    arcs->nn_list = instance->nn_list;
+    arcs->width = arcs->sparse ? instance->nn_ants : num_node;
+    arcs->size = num_node * arcs->width;
+}
+
+/*
+ FUNCTION:       set up the position of the nearest neighbour arcs in each row
+ INPUT:          problem instance, nn_list and the arc layout have to be set up
+ OUTPUT:         none
+ */
+void init_arc_columns (Problem *instance)
+{
+    int i, *identity;
+    ArcLayout *arcs = &instance->arcs;
+    int num_node = instance->num_node;
+    
+    if (!arcs->sparse) {
+        /* 近邻弧在行内的位置即近邻点本身 */
+        for (i = 0; i < num_node; i++) {
+            arcs->nn_col[i] = instance->nn_list[i];
+        }
+    } else {
+        /* 所有行共用一个 0..width-1 的数组 */
+        identity = (int *)(arcs->nn_col + instance->capacity);
+        for (i = 0; i < arcs->width; i++) {
+            identity[i] = i;
+        }
+        for (i = 0; i < num_node; i++) {
+            arcs->nn_col[i] = identity;
+        }
+    }
+}
+
+/*
+ FUNCTION:       malloc a vector holding one value per arc of the instance layout
+ INPUT:          problem instance
+ OUTPUT:         pointer to the vector, the extra last element holds the value
+                 of the arcs not stored in a sparse layout
+ */
+real_t *generate_arc_vector(Problem *instance)
+{
+    real_t *values;
+    
+    if ((values = (real_t *)calloc(instance->arcs.size + 1, sizeof(real_t))) == NULL) {
+        printf("Out of memory, exit.");
+        exit(1);
+    }
+    return values;
 }
 
 /*
@@ -147,76 +368,202 @@ void exit_sub_problem(Problem *sub)
 void allocate_ants (Problem *instance)
 {
     int i;
+    int capacity = instance->capacity;
     AntStruct *ants, *best_so_far_ant;
-    double   *prob_of_selection;
     
-    if((ants = (AntStruct *)malloc(sizeof( AntStruct ) * instance->n_ants +
-                                   sizeof(AntStruct *) * instance->n_ants)) == NULL){
+    if((ants = (AntStruct *)malloc(sizeof( AntStruct ) * capacity)) == NULL){
         printf("Out of memory, exit.");
         exit(1);
     }
-    for (i = 0 ; i < instance->n_ants ; i++) {
-        ants[i].tour        = (int *)calloc(2*instance->num_node-1, sizeof(int));   // tour最长为2 * num_node - 1
-        ants[i].visited     = (bool *)calloc(instance->num_node, sizeof(bool));
-        ants[i].candidate = (bool *)calloc(instance->num_node, sizeof(bool));
+    for (i = 0 ; i < capacity ; i++) {
+        ants[i].tour        = (int *)calloc(2*capacity-1, sizeof(int));   // tour最长为2 * num_node - 1
+        ants[i].unvisited     = (int *)calloc(capacity, sizeof(int));
+        ants[i].unvisited_pos = (int *)calloc(capacity, sizeof(int));
     }
     
     if((best_so_far_ant = (AntStruct *)malloc(sizeof(AntStruct))) == NULL){
         printf("Out of memory, exit.");
         exit(1);
     }
-    best_so_far_ant->tour        = (int *)calloc(2*instance->num_node-1, sizeof(int));
-    best_so_far_ant->visited     = (bool *)calloc(instance->num_node, sizeof(bool));
-    
-    if ((prob_of_selection = (double *)malloc(sizeof(double) * (instance->nn_ants + 1))) == NULL) {
-        printf("Out of memory, exit.");
-        exit(1);
-    }
-    /* Ensures that we do not run over the last element in the random wheel.  */
-    prob_of_selection[instance->nn_ants] = HUGE_VAL;
+    best_so_far_ant->tour        = (int *)calloc(2*capacity-1, sizeof(int));
     
     instance->ants = ants;
     instance->best_so_far_ant = best_so_far_ant;
-    instance->prob_of_selection = prob_of_selection;
 }
 
 /*
- * 参数设置
+ FUNCTION:       reset the construction memory of the ants for the current num_node
+ INPUT:          problem instance
+ OUTPUT:         none
+ */
+void init_ants (Problem *instance)
+{
+    int i, j;
+    AntStruct *ants = instance->ants;
+    
+    for (i = 0 ; i < instance->n_ants ; i++) {
+        ants[i].min_demand_pos = 0;
+        /* unvisited 始终是所有配送点的一个排列, 因此清空蚂蚁记忆只需重置 n_unvisited */
+        for (j = 1; j < instance->num_node; j++) {
+            ants[i].unvisited[j-1] = j;
+            ants[i].unvisited_pos[j] = j-1;
+        }
+        ants[i].unvisited_pos[0] = instance->num_node;    /* depot不在unvisited中 */
+        ants[i].n_unvisited = 0;
+    }
+}
+
+/*
+ * 调节参数的默认值
+ */
+void default_solver_config(SolverConfig *config)
+{
+    config->alpha                = 1.0;
+    config->beta                 = 2.0;
+    config->rho                  = 0.1;
+    config->ras_ranks            = 6;       /* number of ranked ants, top-{ras_ranks} ants */
+    
+    /* apply local search */
+    config->ls_flag              = TRUE;
+    /* apply don't look bits in local search */
+    config->dlb_flag             = TRUE;
+    /* apply Or-opt / Or-3opt after 2-opt (off by default) */
+    config->or_opt_flag          = FALSE;
+    config->or3_opt_flag         = FALSE;
+    /* apply inter-route local search (off by default) */
+    config->inter_ls_flag        = FALSE;
+    /* 默认对所有蚂蚁做local search, TOP_K/CHANGED/BUDGET 需显式开启 */
+    config->ls_policy            = LS_POLICY_ALL;
+    config->ls_top_k             = 10;      /* LS_POLICY_TOP_K */
+    config->ls_time_budget       = 1.0;     /* LS_POLICY_BUDGET, 秒 */
+    config->sa_flag              = true;
+    config->tabu_flag            = true;
+    config->tabu_tenure          = 3;
+    config->sa_replicas          = 1;       /* 1: 单个SA */
+    config->sa_ladder_ratio      = 1.5;
+    config->sa_batch_size        = 16;
+    
+    config->alias_flag           = false;
+    config->alias_rejections     = 8;
+    
+    /* 大规模实例只在近邻弧上保存信息素与total_info */
+    config->sparse_threshold     = 2000;
+    
+    config->max_runtime          = 600.0;
+    /* maximum number of iterations */
+    config->max_iteration        = 10000;
+    
+    // parallel aco
+    config->master_iteration_num = 1;       /* 每次外循环，主问题蚁群的迭代次数 */
+    config->sub_iteration_num    = 75;      /* 每次外循环，子问题蚁群的迭代次数 */
+    config->pipeline_flag        = false;   /* master与sub流水线并行(默认关闭) */
+    
+    // island model
+    config->migration_interval   = 25;      /* 每隔多少次迭代交换各岛的最优解 */
+}
+
+/*
+ * 参数设置: 由实例规模决定的参数, 调节参数见 SolverConfig
  */
 void set_default_parameters (Problem *instance)
 {
     /* number of ants */
     instance->n_ants         = instance->num_node;
     /* number of nearest neighbours in tour construction(neighbor不应该包括depot和自身) */
-    instance->nn_ants        = instance->num_node - 2;//MIN(MAX(instance->n_ants>>2, 25), instance->num_node - 2);
+    instance->nn_ants        = MAX(MIN(30, instance->num_node - 2), 0);
     /* use fixed radius search in the 20 nearest neighbours */
-    instance->nn_ls          = instance->nn_ants;//MIN(instance->nn_ants, 25);
+    instance->nn_ls          = MIN(instance->nn_ants, 20);
+    /* 候选列表中的点都不可行时, 在4倍长度的扩展近邻列表中选择最近的可行点 */
+    instance->nn_ext         = MAX(MIN(4 * instance->nn_ants, instance->num_node - 2), 0);
     
     /* maximum number of iterations */
-    instance->max_iteration  = 10000;
+    instance->max_iteration  = instance->config.max_iteration;
     /* optimal tour length if known, otherwise a bound */
 //    instance->optimum        = 1;
     /* counter of number iterations */
     instance->iteration      = 0;
     
-    /* apply local search */
-    instance->ls_flag        = TRUE;
-    /* apply don't look bits in local search */
-    instance->dlb_flag       = TRUE;
-    
-    alpha          = 1.0;
-    beta           = 2.0;
-    rho            = 0.1;
-    ras_ranks      = 6;          /* number of ranked ants, top-{ras_ranks} ants */
-    
-    instance->rnd_seed       = (int) time(NULL);
-    instance->max_runtime    = 600.0;
+    /* 每个核一个线程构造解 */
+    instance->num_threads    = MAX(MIN((int)sysconf(_SC_NPROCESSORS_ONLN), instance->n_ants), 1);
     
     // parallel aco
-    g_master_problem_iteration_num    = 1;      /* 每次外循环，主问题蚁群的迭代次数 */
-    g_sub_problem_iteration_num       = 75;     /* 每次外循环，子问题蚁群的迭代次数 */
     instance->num_subs                = instance->num_node/50;
+    instance->num_sub_threads         = instance->num_threads;
     
+    // island model
+    instance->num_islands             = MAX((int)sysconf(_SC_NPROCESSORS_ONLN), 1);    /* 每个核一个岛 */
+    
+}
+
+/*
+ * 子问题与岛沿用主问题(所在try)的调节参数、计时起点和report文件,
+ * 需要在compute_problem之前调用(heuristic依赖beta)
+ */
+void inherit_parameters (Problem *master, Problem *instance)
+{
+    instance->config               = master->config;
+    instance->start_time           = master->start_time;
+    instance->deadline             = master->deadline;
+    instance->report               = master->report;
+    instance->best_so_far_report   = master->best_so_far_report;
+    instance->iter_report          = master->iter_report;
+    instance->anneal_report        = master->anneal_report;
+}
+
+/*
+ FUNCTION:       checks whether termination condition is met
+ INPUT:          none
+ OUTPUT:         0 if condition is not met, number neq 0 otherwise
+ (SIDE)EFFECTS:  none
+ */
+bool termination_condition(Problem *instance)
+{
+    return ((instance->iteration >= instance->max_iteration) ||
+            deadline_expired(instance->deadline) ||
+            (fabs(instance->best_so_far_ant->tour_length - instance->optimum) < 10 * EPSILON));
+}
+
+/*
+ * 当前try已运行的时间(real time), 多个try并发运行时各自计时
+ */
+double elapsed_run_time(Problem *instance)
+{
+    return real_clock() - instance->start_time;
+}
+
+/*
+ * 从现在起 seconds 秒后到期
+ */
+void init_deadline(Deadline *deadline, double seconds)
+{
+    deadline->end = coarse_clock() + seconds;
+    deadline->cancelled = 0;
+}
+
+/*
+ * 取消: 之后所有的 deadline_expired 都返回true
+ */
+void cancel_deadline(Deadline *deadline)
+{
+    __atomic_store_n(&deadline->cancelled, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * 是否已到期或被取消. 读取 coarse_clock, 开销很小, 但热循环中仍应使用 deadline_poll
+ */
+bool deadline_expired(Deadline *deadline)
+{
+    if (deadline == NULL) {
+        return false;
+    }
+    if (__atomic_load_n(&deadline->cancelled, __ATOMIC_RELAXED)) {
+        return true;
+    }
+    if (coarse_clock() >= deadline->end) {
+        cancel_deadline(deadline);
+        return true;
+    }
+    return false;
 }
 
 /*
@@ -17,21 +17,21 @@
 #include <stdio.h>
 #include <bitset>
 #include <vector>
+#include "rng.h"
 
 using namespace std;
 
 #define LINE_BUF_LEN     255
 
-/*************** global variables *********************/
-
-extern int g_master_problem_iteration_num;   /* 每次外循环，主问题蚁群的迭代的次数 */
-extern int g_sub_problem_iteration_num;      /* 每次外循环，子问题蚁群的迭代次数 */
-
-extern double rho;           /* parameter for evaporation */
-extern double alpha;         /* importance of trail */
-extern double beta;          /* importance of heuristic evaluate */
-extern int ras_ranks;   /* additional parameter for rank-based version of ant system */
-extern bool sa_flag;
+/*
+ * 距离矩阵和弧数据(heuristic, pheromone, total_info)的存储精度.
+ * 'make PRECISION=float' 时以单精度保存, 减少选择下一个node时的访存; 路程长度仍以double累加
+ */
+#ifdef FLOAT_PRECISION
+typedef float  real_t;
+#else
+typedef double real_t;
+#endif
 
 /****************** data struct ***********************/
 enum DistanceTypeEnum {
@@ -59,6 +59,60 @@ struct Route {
     double dist;                    /* route distance */
 };
 
+/*
+ * 距离矩阵. 主问题直接访问自身的矩阵;
+ * 子问题不复制距离矩阵, 通过 real_nodes 将子问题编号映射到主问题矩阵上(zero-copy view)
+ */
+struct DistanceMatrix {
+    real_t      **rows;         /* 主问题的距离矩阵 */
+    const int   *map;           /* 子问题编号 -> 主问题编号, 主问题为NULL */
+    
+    inline real_t operator()(int i, int j) const {
+        return map == NULL ? rows[i][j] : rows[map[i]][map[j]];
+    }
+};
+
+/*
+ * 弧数据(pheromone, total_info, heuristic)的存储方式, 同一问题的所有弧数据共用一个layout.
+ * 1) dense:  保存全部 n×n 条弧, 弧(i,j)位于 i * width + j
+ * 2) sparse: 每行只保存 nn_list[i] 中前width条弧(CSR, 与nn_list对齐), 弧(i,nn_list[i][k])位于 i * width + k,
+ *            其它弧不保存, 读取时为默认值(存放在数组末尾, 即下标size处)
+ */
+struct ArcLayout {
+    bool  sparse;
+    int   num_node;
+    int   width;          /* 每行保存的弧数 */
+    int   size;           /* 保存的弧总数, num_node * width */
+    int   **nn_list;
+    int   **nn_col;       /* 近邻弧在行内的位置: dense时即nn_list, sparse时为 0..width-1 */
+    
+    /* 弧(i,j)的位置, 不保存该弧时返回-1 */
+    inline int slot(int i, int j) const {
+        if (!sparse) {
+            return i * width + j;
+        }
+        for (int k = 0; k < width; k++) {
+            if (nn_list[i][k] == j) {
+                return i * width + k;
+            }
+        }
+        return -1;
+    }
+    /* 弧(i, nn_list[i][k])的位置, k < width */
+    inline int nn_slot(int i, int k) const {
+        return i * width + nn_col[i][k];
+    }
+    /* 行i中第c条保存的弧的终点 */
+    inline int node(int i, int c) const {
+        return sparse ? nn_list[i][c] : c;
+    }
+    /* 弧(i,j)的值, 不保存的弧取默认值 */
+    inline double value(const real_t *values, int i, int j) const {
+        int s = slot(i, j);
+        return s < 0 ? values[size] : values[s];
+    }
+};
+
 /*
  * ant tour consists of some single route.
  * a single route begin with depot(0) and end with depot(0),
@@ -68,59 +122,172 @@ struct AntStruct {
     int  *tour;
     int  tour_size;     /* 路程中经过的点个数（depot可能出现多次） */
     double  tour_length;     /* 车辆路程行走长度 */
-    bool      *visited;      /* mark nodes visited status */
-    bool      *candidate;  /** 所有可配送的点(单次route中，目前车辆可以仍可配送的点) */
+    
+    /*----- solution construction only -----*/
+    int  *unvisited;         /* 未访问的配送点, 只有前n_unvisited个有效; 访问后与末尾元素交换(swap-remove) */
+    int  *unvisited_pos;     /* 配送点在unvisited中的位置, unvisited_pos[i] >= n_unvisited 表示i已访问 */
+    int  n_unvisited;        /* 未访问的配送点个数 */
+    int  min_demand_pos;     /* demand_order中第一个未访问的点的位置, 即剩余需求量最小的点 */
+    int  route_load;         /* 当前route的送货量 */
+    double  route_dist;      /* 当前route的行驶距离(包括service time) */
 };
 
 
+/*
+ * 求解器的调节参数.
+ * Problem 构造时取默认值(见default_solver_config), 调用者可以在 init_problem 之前修改;
+ * init_problem 和 init_sub_problem 不会覆盖它, 子问题与岛复制主问题的 config.
+ * 参数不再是全局变量, 因此不同参数的多个求解器可以在同一进程中并发运行
+ */
+
+/* local search 作用于哪些蚂蚁(SolverConfig.ls_policy), 可以组合; 0 为全部蚂蚁 */
+#define LS_POLICY_ALL       0
+#define LS_POLICY_TOP_K     1       /* 只对构造出的解最短的 ls_top_k 只蚂蚁 */
+#define LS_POLICY_CHANGED   2       /* 跳过与上次迭代中某只蚂蚁的解相同的蚂蚁 */
+#define LS_POLICY_BUDGET    4       /* 每次迭代最多用时 ls_time_budget, 按解的长度从短到长 */
+
+struct SolverConfig {
+    double alpha;                  /* importance of trail */
+    double beta;                   /* importance of heuristic evaluate */
+    double rho;                    /* parameter for evaporation */
+    int ras_ranks;                 /* additional parameter for rank-based version of ant system */
+    
+    bool ls_flag;                  /* indicates whether and which local search is used */
+    bool dlb_flag;                 /* flag indicating whether don't look bits are used. I recommend
+                                      to always use it if local search is applied */
+    bool or_opt_flag;              /* 2-opt之后是否使用Or-opt(将1~3个点的段移动到route中其它位置) */
+    bool or3_opt_flag;             /* Or-opt 是否允许将段反向插入(Or-3opt) */
+    bool inter_ls_flag;            /* 是否使用跨route的局部搜索(relocate, swap, 2-opt*, cross-exchange) */
+    int ls_policy;                 /* LS_POLICY_* 的组合 */
+    int ls_top_k;
+    double ls_time_budget;         /* 每次迭代local search的时间上限(秒) */
+    bool sa_flag;                  /* 是否使用sa */
+    bool tabu_flag;                /* sa 是否使用禁忌表 */
+    int tabu_tenure;               /* 被接受的移动的逆移动在之后多少步内是禁忌的 */
+    int sa_replicas;               /* >1 时用parallel tempering: 多个replica在不同温度上同时退火并交换温度,
+                                      实际数目不超过蚁群的线程数 */
+    double sa_ladder_ratio;        /* parallel tempering 相邻两个replica的温度之比 */
+    int sa_batch_size;             /* SA每步最多一次采样并评估的候选移动数 */
+    
+    bool alias_flag;               /* 用alias table + rejection选择下一个node, 代替每步O(nn_ants)的轮盘赌 */
+    int alias_rejections;          /* 连续抽到不可行的点这么多次后, 改用精确的轮盘赌 */
+    
+    int sparse_threshold;          /* num_node 超过该值时只在近邻弧上保存信息素与total_info(sparse layout),
+                                      0 表示总是使用dense layout */
+    
+    double max_runtime;            /* maximal allowed run time */
+    int max_iteration;             /* maximum number of iterations of the master problem */
+    
+    /*----- parallel aco -----*/
+    int master_iteration_num;      /* 每次外循环，主问题蚁群的迭代次数 */
+    int sub_iteration_num;         /* 每次外循环，子问题蚁群的迭代次数 */
+    bool pipeline_flag;            /* 子问题在后台求解时主问题继续迭代 */
+    
+    /*----- island model -----*/
+    int migration_interval;        /* 各岛交换最优解的迭代间隔 */
+};
+
+void default_solver_config(SolverConfig *config);
+
+#define DEADLINE_CHECK_INTERVAL 64  /* deadline_poll 每调用这么多次才读一次时钟 */
+
+/*
+ * 一次try的截止时间与取消标志. 主问题、子问题与岛共享同一个,
+ * 各求解线程、SA、LS 在循环中检查, 到期或被取消后尽快返回
+ */
+struct Deadline {
+    double end;                 /* coarse_clock() 到达该值时到期 */
+    int    cancelled;           /* 到期或被取消后为1; 多个线程同时读写, 只用 __atomic 访问 */
+};
+
+void init_deadline(Deadline *deadline, double seconds);
+void cancel_deadline(Deadline *deadline);
+bool deadline_expired(Deadline *deadline);
+
+/*
+ * 分摊检查: countdown 属于调用者, 每 DEADLINE_CHECK_INTERVAL 次才检查一次
+ */
+inline bool deadline_poll(Deadline *deadline, int *countdown)
+{
+    if (--(*countdown) > 0) {
+        return false;
+    }
+    *countdown = DEADLINE_CHECK_INTERVAL;
+    return deadline_expired(deadline);
+}
+
 struct Problem {
-    Problem(short id): pid(id){}
+    Problem(short id): pid(id), capacity(0), arc_capacity(0), deadline(NULL), rnd_seed(0), sub_index(NULL),
+        report(NULL), best_so_far_report(NULL), iter_report(NULL), anneal_report(NULL)
+    {
+        default_solver_config(&config);
+    }
     
-    short         pid;                      /* 主问题id = 0, 子问题id递增 */
+    short         pid;                      /* 主问题id = 0, 子问题id递增(从1开始), 岛(island model)id为负数 */
     char          name[LINE_BUF_LEN];      	 /* instance name */
     char          edge_weight_type[LINE_BUF_LEN];  /* selfexplanatory */
     DistanceTypeEnum dis_type;               /* 用于决定使用哪种距离方式 */
     double        optimum;                /* optimal tour length if known, otherwise a bound */
     int      num_node;               /* number of nodes, depot included, numd_node = 1(depot) + num of target nodes*/
+    int      capacity;               /* 缓冲区(distance, nn_list, ants等)可容纳的最大num_node */
+    int      arc_capacity;           /* heuristic, pheromone等弧向量可容纳的弧数 */
     Point         *nodeptr;               /* array of structs containing coordinates of nodes */
-    double        **distance;             /* distance matrix: distance[i][j] gives distance
+    DistanceMatrix distance;              /* distance matrix: distance(i, j) gives distance
                                            between node i und j */
+    real_t        *heuristic;             /* heuristic information to the power of beta, see arcs */
     int      **nn_list;              /* nearest neighbor list; contains for each node i a
-                                           sorted list of n_near nearest neighbors */
+                                           sorted list of nn_ext nearest neighbors */
+    int      *demand;                /* 各点的需求量(即nodeptr[i].demand), 连续存放以便向量化读取 */
+    int      *demand_order;          /* 配送点按需求量升序排列, 用于判断剩余装载量能否再配送任何点 */
     int      vehicle_capacity;       /* 车辆最大装载量 */
     double        max_distance;           /* 最大行驶距离 */
     double        service_time;           /*  service time needed for node */
     
     
+    SolverConfig  config;                 /* 调节参数 */
+    
     /*----- local search -----*/
-    bool ls_flag;          /* indicates whether and which local search is used */
     int nn_ls;            /* maximal depth of nearest neighbour lists used in the
                                 local search */
-    bool dlb_flag;         /* flag indicating whether don't look bits are used. I recommend
-                                to always use it if local search is applied */
     
     int iteration;           /* counter of number iterations */
-    int max_iteration;       /* maximum number of iterations */
+    int max_iteration;       /* maximum number of iterations, 主问题取config.max_iteration,
+                                子问题取config.sub_iteration_num */
     
     /*----- ant info -----*/
     AntStruct *ants;                   /* this (array of) struct will hold the colony */
     AntStruct *best_so_far_ant;        /* struct that contains the best-so-far ant */
     AntStruct *iteration_best_ant;     /* 当前迭代表现最好的蚂蚁 */
     
-    double   **pheromone;               /* pheromone matrix, one entry for each arc */
-    double   **total_info;              /* combination of pheromone and heuristic information */
-    
-    double   *prob_of_selection;        /* 依概率选择下一个node */
+    ArcLayout arcs;                     /* layout of pheromone, total_info and heuristic */
+    real_t   *pheromone;                /* pheromone of each arc stored in arcs */
+    real_t   *total_info;               /* combination of pheromone and heuristic information */
+    real_t   *alias_prob;               /* 仅当config.alias_flag, 各点候选列表(nn_ants)上total_info的
+                                           Walker alias table: 第k格保留自身的概率 */
+    int      *alias_index;              /* 仅当config.alias_flag, 第k格的另一个候选(在候选列表中的位置) */
     
     int n_ants;                    /* number of ants */
     int nn_ants;                   /* length of nearest neighbor lists for the ants'
                                          solution construction */
+    int nn_ext;                    /* 扩展近邻列表长度(nn_list的实际深度), 候选列表中的点都不可行时,
+                                      在扩展近邻列表中选择下一个点 */
     
-    double   max_runtime;               /* maximal allowed run time */
+    double   start_time;                /* try开始时的real_clock(), 子问题与岛继承主问题的值 */
+    Deadline *deadline;                 /* 由 run_try 设置, 子问题与岛继承主问题的值; NULL 表示没有截止时间 */
     double   best_so_far_time;          /* 当前最优解出现的时间 */
     int best_solution_iter;        /* iteration in which best solution is found */
     
-    int rnd_seed;                  /* 用于生成随机数的种子 */
+    int rnd_seed;                  /* 用于生成随机数的种子, 为0时 init_problem 取当前时间 */
+    Rng rng;                       /* 问题级随机数流(分解、SA), 只在求解该问题的线程中使用;
+                                      子问题与岛的流由主问题的流派生 */
+    int num_threads;               /* 蚁群内部并行构造解/局部搜索的线程数 */
+    
+    /*----- local search statistics -----*/
+    double ls_time;                /* local search 总耗时 */
+    int ls_ants;                   /* 做了local search的蚂蚁数 */
+    int ls_skipped_top_k;          /* 各策略跳过的蚂蚁数, 见 LS_POLICY_* */
+    int ls_skipped_changed;
+    int ls_skipped_budget;         /* 包括到达截止时间(Deadline)后跳过的蚂蚁 */
     
     double last_iter_solution;          /* 上一次迭代的解 */
     int iter_stagnate_cnt;         /* 迭代停滞计数器，记录解迭代解停滞的次数 */
@@ -128,15 +295,28 @@ struct Problem {
     
     /*----- sub problem only -----*/
     int num_subs;                  /* 仅用于parallel版本蚁群, 子问题个数 */
+    int num_sub_threads;           /* 仅用于parallel版本蚁群, 求解子问题的线程数 */
+    int num_islands;               /* 仅用于island model, 岛(独立蚁群)的个数 */
     vector<int> real_nodes;        /* 仅用于sub-problem, sub nodes需要重新编号，因此需要额外数组记录nodes真实的编号 */
-    double   **best_pheromone;          /* 仅用于sub-problem, 记录sub 获得best_so_far_solution时候的信息素
+    int      *sub_index;           /* 仅用于master, 正在初始化的子问题中各node的编号(real_nodes的逆映射), 不在子问题中为-1 */
+    real_t   *best_pheromone;           /* 仅用于sub-problem, 记录sub 获得best_so_far_solution时候的信息素
                                            用于sub 迭代结束时更新至master */
+    
+    /*----- report, 每个try独立的输出文件, 子问题与主问题共用 -----*/
+    FILE     *report;
+    FILE     *best_so_far_report;
+    FILE     *iter_report;
+    FILE     *anneal_report;
 };
 
 void init_problem(Problem *instance);
+real_t *generate_arc_vector(Problem *instance);
 void exit_problem(Problem *instance);
 void init_sub_problem(Problem *master, Problem *sub);
 void exit_sub_problem(Problem *sub);
+void init_island_problem(Problem *master, Problem *island);
+double elapsed_run_time(Problem *instance);
+bool termination_condition(Problem *instance);
 bool check_solution(Problem *instance, int *tour, int tour_size);
 bool check_route(Problem *instance, int *tour, int rbeg, int rend);
 
@@ -0,0 +1,93 @@
+/*********************************
+
+ Ant Colony Optimization algorithms (AS, ACS, EAS, RAS, MMAS) for CVRP
+
+ Created by 孙晓奇 on 2016/10/8.
+ Copyright © 2016年 xiaoqi.sxq. All rights reserved.
+
+ Program's name: acovrp
+ Purpose: per-thread random number streams (xoshiro256++)
+
+ email: sunxq1991@gmail.com
+
+ *********************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rng.h"
+
+/* 64位常量, 避免 C++98 -pedantic 不支持的 long long 字面量 */
+#define U64(hi, lo)  (((uint64_t)(hi) << 32) | (uint64_t)(lo))
+
+/*
+ FUNCTION:       initialize the stream from an integer seed
+ INPUT:          stream, seed
+ OUTPUT:         none
+ (SIDE)EFFECTS:  the state is expanded from the seed by splitmix64, so any seed
+                 (including 0) gives a valid state
+ */
+void rng_seed(Rng *rng, int seed)
+{
+    uint64_t z, x = (uint64_t)(unsigned int)seed;
+
+    for (int i = 0; i < 4; i++) {
+        x += U64(0x9e3779b9, 0x7f4a7c15);
+        z = x;
+        z = (z ^ (z >> 30)) * U64(0xbf58476d, 0x1ce4e5b9);
+        z = (z ^ (z >> 27)) * U64(0x94d049bb, 0x133111eb);
+        rng->s[i] = z ^ (z >> 31);
+    }
+    rng->pos = RNG_BATCH;
+}
+
+/*
+ FUNCTION:       derive an independent stream
+ INPUT:          parent stream, child stream
+ OUTPUT:         none
+ (SIDE)EFFECTS:  child continues from the current state of the parent, the
+                 parent jumps 2^128 steps ahead, so the two never overlap
+ */
+void rng_split(Rng *rng, Rng *child)
+{
+    static const uint64_t JUMP[] = {
+        U64(0x180ec6d3, 0x3cfd0aba), U64(0xd5a61266, 0xf0c9392c),
+        U64(0xa9582618, 0xe03fc9aa), U64(0x39abdc45, 0x29b1661c)
+    };
+    uint64_t s[4] = {0, 0, 0, 0};
+
+    for (int i = 0; i < 4; i++) {
+        child->s[i] = rng->s[i];
+    }
+    child->pos = RNG_BATCH;
+
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (JUMP[i] & ((uint64_t)1 << b)) {
+                s[0] ^= rng->s[0];
+                s[1] ^= rng->s[1];
+                s[2] ^= rng->s[2];
+                s[3] ^= rng->s[3];
+            }
+            rng_next(rng);
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        rng->s[i] = s[i];
+    }
+    rng->pos = RNG_BATCH;
+}
+
+/*
+ FUNCTION:       bulk generation of uniform random numbers
+ INPUT:          stream, output array, number of values
+ OUTPUT:         none
+ (SIDE)EFFECTS:  values[0..n-1] are uniformly distributed in [0,1), built from
+                 the upper 53 bits of each 64 bit output
+ */
+void rng_fill_uniform(Rng *rng, double *values, int n)
+{
+    for (int i = 0; i < n; i++) {
+        values[i] = (double)(rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+    }
+}
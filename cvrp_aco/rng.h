@@ -0,0 +1,77 @@
+/*********************************
+
+ Ant Colony Optimization algorithms (AS, ACS, EAS, RAS, MMAS) for CVRP
+
+ Created by 孙晓奇 on 2016/10/8.
+ Copyright © 2016年 xiaoqi.sxq. All rights reserved.
+
+ Program's name: acovrp
+ Purpose: per-thread random number streams (xoshiro256++)
+
+ email: sunxq1991@gmail.com
+
+ *********************************/
+
+#ifndef rng_h
+#define rng_h
+
+#include <stdint.h>
+
+#define RNG_BATCH 64
+
+/*
+ * xoshiro256++ 随机数流. 每个线程(蚁群工作线程、子问题、岛)拥有自己的 Rng,
+ * 不加锁; 新的流通过 rng_split 从父流派生, 相互之间不重叠(相距 2^128).
+ * rng_uniform 从预先批量生成的 batch 中取数, 用于构造解和SA等最内层的循环.
+ */
+struct Rng {
+    uint64_t s[4];
+    int      pos;                  /* batch 中下一个未使用的位置 */
+    double   batch[RNG_BATCH];     /* 批量生成的 [0,1) 均匀分布随机数 */
+};
+
+void rng_seed(Rng *rng, int seed);
+void rng_split(Rng *rng, Rng *child);
+void rng_fill_uniform(Rng *rng, double *values, int n);
+
+/*
+ * 下一个64位随机数
+ */
+inline uint64_t rng_next(Rng *rng)
+{
+    uint64_t *s = rng->s;
+    uint64_t x = s[0] + s[3];
+    uint64_t result = ((x << 23) | (x >> 41)) + s[0];
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+
+    return result;
+}
+
+/*
+ * 在 [0,1) 上均匀分布的随机数, 取自 batch
+ */
+inline double rng_uniform(Rng *rng)
+{
+    if (rng->pos == RNG_BATCH) {
+        rng_fill_uniform(rng, rng->batch, RNG_BATCH);
+        rng->pos = 0;
+    }
+    return rng->batch[rng->pos++];
+}
+
+/*
+ * 在 {0, ..., n-1} 上均匀分布的整数, n > 0
+ */
+inline int rng_int(Rng *rng, int n)
+{
+    return (int)(((rng_next(rng) >> 32) * (uint64_t)n) >> 32);
+}
+
+#endif /* rng_h */
@@ -0,0 +1,187 @@
+/*********************************
+
+ Ant Colony Optimization algorithms (AS, ACS, EAS, RAS, MMAS) for CVRP
+
+ Created by 孙晓奇 on 2016/10/8.
+ Copyright © 2016年 xiaoqi.sxq. All rights reserved.
+
+ Program's name: acovrp
+ Purpose: roulette wheel selection kernels (AVX2 and scalar)
+
+ email: sunxq1991@gmail.com
+
+ *********************************/
+
+#include <stdio.h>
+
+#include "roulette.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ROULETTE_AVX2
+#include <immintrin.h>
+#endif
+
+/* ------------------------------ scalar ------------------------------ */
+
+static void mask_scalar(const int *nodes, const int *unvisited_pos, int n_unvisited,
+                        const int *demand, int max_demand, int *mask, int n)
+{
+    int node;
+
+    for (int i = 0; i < n; i++) {
+        node = nodes[i];
+        mask[i] = -((unvisited_pos[node] < n_unvisited) & (demand[node] <= max_demand));
+    }
+}
+
+static double weights_scalar(const real_t *info_row, const int *col, const int *mask, double *prob, int n)
+{
+    double sum = 0.0;
+
+    for (int i = 0; i < n; i++) {
+        prob[i] = mask[i] ? info_row[col[i]] : 0.0;
+        sum += prob[i];
+    }
+    return sum;
+}
+
+static int search_scalar(const double *prob, int n, double target)
+{
+    double partial_sum = 0.0;
+
+    for (int i = 0; i < n; i++) {
+        partial_sum += prob[i];
+        if (partial_sum > target) {
+            return i;
+        }
+    }
+    return n;
+}
+
+/* ------------------------------- AVX2 ------------------------------- */
+
+#ifdef ROULETTE_AVX2
+
+/*
+ * 每次处理8个近邻: gather unvisited_pos 与 demand, 两次比较
+ */
+__attribute__((target("avx2")))
+static void mask_avx2(const int *nodes, const int *unvisited_pos, int n_unvisited,
+                      const int *demand, int max_demand, int *mask, int n)
+{
+    __m256i idx, pos, dem, ok;
+    __m256i limit_pos = _mm256_set1_epi32(n_unvisited);
+    __m256i limit_dem = _mm256_set1_epi32(max_demand);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        idx = _mm256_loadu_si256((const __m256i *)(nodes + i));
+        pos = _mm256_i32gather_epi32(unvisited_pos, idx, 4);
+        dem = _mm256_i32gather_epi32(demand, idx, 4);
+        /* pos < n_unvisited && !(dem > max_demand) */
+        ok = _mm256_andnot_si256(_mm256_cmpgt_epi32(dem, limit_dem), _mm256_cmpgt_epi32(limit_pos, pos));
+        _mm256_storeu_si256((__m256i *)(mask + i), ok);
+    }
+    mask_scalar(nodes + i, unvisited_pos, n_unvisited, demand, max_demand, mask + i, n - i);
+}
+
+/*
+ * 每次处理4个近邻: 按 mask 从 info_row gather (不可行的点不读内存), 4路累加
+ */
+__attribute__((target("avx2")))
+static double weights_avx2(const real_t *info_row, const int *col, const int *mask, double *prob, int n)
+{
+    __m256d v, acc = _mm256_setzero_pd();
+    __m128i idx, m;
+    __m128d sum;
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        idx = _mm_loadu_si128((const __m128i *)(col + i));
+        m = _mm_loadu_si128((const __m128i *)(mask + i));
+#ifdef FLOAT_PRECISION
+        v = _mm256_cvtps_pd(_mm_mask_i32gather_ps(_mm_setzero_ps(), info_row, idx,
+                                                  _mm_castsi128_ps(m), 4));
+#else
+        v = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), info_row, idx,
+                                     _mm256_castsi256_pd(_mm256_cvtepi32_epi64(m)), 8);
+#endif
+        _mm256_storeu_pd(prob + i, v);
+        acc = _mm256_add_pd(acc, v);
+    }
+
+    sum = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+    sum = _mm_add_sd(sum, _mm_unpackhi_pd(sum, sum));
+    return _mm_cvtsd_f64(sum) + weights_scalar(info_row, col + i, mask + i, prob + i, n - i);
+}
+
+/*
+ * 每次处理4个: 寄存器内前缀和(两次移位相加), 加上之前的累计值后与 target 比较
+ */
+__attribute__((target("avx2")))
+static int search_avx2(const double *prob, int n, double target)
+{
+    __m256d x, zero = _mm256_setzero_pd(), carry = _mm256_setzero_pd();
+    __m256d t = _mm256_set1_pd(target);
+    int i = 0, m;
+
+    for (; i + 4 <= n; i += 4) {
+        x = _mm256_loadu_pd(prob + i);
+        /* [x0, x0+x1, x1+x2, x2+x3] */
+        x = _mm256_add_pd(x, _mm256_blend_pd(_mm256_permute4x64_pd(x, 0x90), zero, 0x1));
+        /* [x0, x0+x1, x0+x1+x2, x0+x1+x2+x3] */
+        x = _mm256_add_pd(x, _mm256_blend_pd(_mm256_permute4x64_pd(x, 0x40), zero, 0x3));
+        x = _mm256_add_pd(x, carry);
+        m = _mm256_movemask_pd(_mm256_cmp_pd(x, t, _CMP_GT_OQ));
+        if (m) {
+            return i + __builtin_ctz(m);
+        }
+        carry = _mm256_permute4x64_pd(x, 0xFF);
+    }
+
+    return i + search_scalar(prob + i, n - i, target - _mm_cvtsd_f64(_mm256_castpd256_pd128(carry)));
+}
+
+static bool cpu_has_avx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+static const bool use_avx2 = cpu_has_avx2();
+
+#endif
+
+/* ----------------------------- dispatch ----------------------------- */
+
+void roulette_mask(const int *nodes, const int *unvisited_pos, int n_unvisited,
+                   const int *demand, int max_demand, int *mask, int n)
+{
+#ifdef ROULETTE_AVX2
+    if (use_avx2) {
+        mask_avx2(nodes, unvisited_pos, n_unvisited, demand, max_demand, mask, n);
+        return;
+    }
+#endif
+    mask_scalar(nodes, unvisited_pos, n_unvisited, demand, max_demand, mask, n);
+}
+
+double roulette_weights(const real_t *info_row, const int *col, const int *mask, double *prob, int n)
+{
+#ifdef ROULETTE_AVX2
+    if (use_avx2) {
+        return weights_avx2(info_row, col, mask, prob, n);
+    }
+#endif
+    return weights_scalar(info_row, col, mask, prob, n);
+}
+
+int roulette_search(const double *prob, int n, double target)
+{
+#ifdef ROULETTE_AVX2
+    if (use_avx2) {
+        return search_avx2(prob, n, target);
+    }
+#endif
+    return search_scalar(prob, n, target);
+}
@@ -0,0 +1,39 @@
+/*********************************
+
+ Ant Colony Optimization algorithms (AS, ACS, EAS, RAS, MMAS) for CVRP
+
+ Created by 孙晓奇 on 2016/10/8.
+ Copyright © 2016年 xiaoqi.sxq. All rights reserved.
+
+ Program's name: acovrp
+ Purpose: roulette wheel selection kernels (AVX2 and scalar)
+
+ email: sunxq1991@gmail.com
+
+ *********************************/
+
+#ifndef roulette_h
+#define roulette_h
+
+#include "problem.h"
+
+/*
+ * 蚂蚁构造解时依概率选择下一个node的各个步骤: 可行性、权重与求和、按前缀和查找.
+ * 支持 AVX2 的 x86 CPU 上使用向量化实现(运行时检测), 否则使用标量实现.
+ * 两种实现求和顺序不同, 结果可能有舍入误差, 调用者需要处理 roulette_search 返回 n 的情况
+ */
+
+/*
+ * mask[i] = -1 若 nodes[i] 未访问(unvisited_pos[nodes[i]] < n_unvisited)且 demand[nodes[i]] <= max_demand,
+ * 否则为 0. 最大行驶距离约束由调用者另外检查
+ */
+void roulette_mask(const int *nodes, const int *unvisited_pos, int n_unvisited,
+                   const int *demand, int max_demand, int *mask, int n);
+
+/* prob[i] = mask[i] ? info_row[col[i]] : 0, 返回 prob[0..n-1] 之和. mask[i] 为 0 或 -1 */
+double roulette_weights(const real_t *info_row, const int *col, const int *mask, double *prob, int n);
+
+/* 第一个满足 prob[0] + ... + prob[i] > target 的 i, 不存在时返回 n */
+int roulette_search(const double *prob, int n, double target);
+
+#endif /* roulette_h */
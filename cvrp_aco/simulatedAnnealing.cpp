@@ -20,8 +20,6 @@
 #include "timer.h"
 #include "io.h"
 
-bool tabu_flag = true;
-
 SimulatedAnnealing::SimulatedAnnealing(Problem *instance, AntColony *ant_colony, double t0,
                                        double alpha, int epoch_length, int terminal_ratio)
 {
@@ -43,23 +41,38 @@ SimulatedAnnealing::SimulatedAnnealing(Problem *instance, AntColony *ant_colony,
     
     iteration = 0;
     epoch_counter = 0;
+    batch_size = 1;
     
     test_cnt = 0;
     improvement_cnt = 0;
     accept_cnt = 0;
     
-    neighbour_search = new NeighbourSearch(instance);
-    local_search = new LocalSearch(instance);
+    rng_split(&instance->rng, &rng);
+    neighbour_search = new NeighbourSearch(instance, &rng);
+    neighbour_search->reset_ant(iter_ant);
     this->ant_colony = ant_colony;
+    
+    tabu_capacity = MAX(instance->config.tabu_tenure, 1);
+    tabu_ring = new Tabu[tabu_capacity];
+    /* 桶数至少为容量的2倍 */
+    tabu_mask = 1;
+    while (tabu_mask < 2 * tabu_capacity) {
+        tabu_mask <<= 1;
+    }
+    tabu_buckets = new int[tabu_mask];
+    tabu_mask--;
+    init_tabu_list();
 }
 
 SimulatedAnnealing::~SimulatedAnnealing()
 {
     delete neighbour_search;
-    delete local_search;
     
-    delete iter_ant->tour;
-    delete best_ant->tour;
+    delete[] tabu_ring;
+    delete[] tabu_buckets;
+    
+    delete[] iter_ant->tour;
+    delete[] best_ant->tour;
     
     delete iter_ant;
     delete best_ant;
@@ -72,77 +85,113 @@ void SimulatedAnnealing::run(void)
         return;
     }
     printf("\n----- Start SA. pid: %d length: %f iter: %d time: %f-----\n",
-           instance->pid, best_ant->tour_length, instance->iteration, elapsed_time( REAL));
+           instance->pid, best_ant->tour_length, instance->iteration, elapsed_run_time(instance));
 //    write_anneal_report(instance, iter_ant, NULL);
     
-    tabu_list.clear();
+    init_tabu_list();
     
-    double beg_time = elapsed_time(REAL), end_time;
-    while (t > (t0 / terminal_ratio)) {
-        step();
-        end_time = elapsed_time(REAL);
-        if(end_time - beg_time > 20) {
-            printf("omg, it happens! pid: %d\n", instance->pid);
-            break;
-        }
+    while (t > (t0 / terminal_ratio) && !deadline_expired(instance->deadline)) {
+        run_epoch();
     }
     
+    commit_best();
+    
+    printf("----- End SA. pid: %d length: %f iter: %d time: %f-----\n",
+           instance->pid, best_ant->tour_length, instance->iteration, elapsed_run_time(instance));
+    
+}
+
+
+/*
+ * 若退火找到的最优解优于问题的当前最优解, 则替换之
+ */
+void SimulatedAnnealing::commit_best(void)
+{
     if (best_ant->tour_length - instance->best_so_far_ant->tour_length < -EPSILON) {
         AntColony::copy_solution_from_to(best_ant, instance->best_so_far_ant);
         if (instance->pid == 0) {
-            instance->best_so_far_time = elapsed_time(REAL);
+            instance->best_so_far_time = elapsed_run_time(instance);
             write_best_so_far_report(instance);
         }
     }
+}
+
+/*
+ * 以当前温度退火一个epoch(epoch_length个有效移动), 结束时降温一次.
+ * 有效移动太少时(如很小的实例), 尝试 20 * epoch_length 步后也结束该epoch;
+ * 到达截止时间时立即返回, 不降温
+ */
+void SimulatedAnnealing::run_epoch(void)
+{
+    double t_beg = t;
+    int tries = 0;
+    int countdown = DEADLINE_CHECK_INTERVAL;
     
-    ant_colony->compute_total_information();
-    printf("----- End SA. pid: %d length: %f iter: %d time: %f-----\n",
-           instance->pid, best_ant->tour_length, instance->iteration, elapsed_time( REAL));
-    
+    while (t == t_beg) {
+        if (tries++ >= 20 * epoch_length) {
+            cool();
+            break;
+        }
+        if (deadline_poll(instance->deadline, &countdown)) {
+            break;
+        }
+        step();
+    }
 }
 
+/*
+ * 降温, 开始新的epoch
+ */
+void SimulatedAnnealing::cool(void)
+{
+    epoch_counter = 0;
+    t = t * alpha;
+    
+    float ar = accept_cnt / (float) test_cnt;
+    float ir = improvement_cnt / (float) test_cnt;
+    DEBUG(printf("Time: %f, T: %f, ar: %f, ir: %f moves:%ld\n", elapsed_run_time(instance), t, ar, ir, test_cnt);)
+    
+    // 平均每接受一个移动需要判断的候选数, 作为下一个epoch的batch大小, 减少被丢弃的候选
+    batch_size = MAX(MIN(test_cnt / (accept_cnt + 1), instance->config.sa_batch_size), 1);
+    test_cnt = accept_cnt = improvement_cnt = 0;
+}
 
 /*
- * 单步退火算法
+ * 单步退火算法: 一次采样并评估 batch_size 个候选移动, 依次判断, 接受第一个可接受的移动.
+ * 被拒绝的移动不改变当前解, 所以这与逐个采样、逐个判断等价; 接受之后其余的候选失效, 直接丢弃
  */
 bool SimulatedAnnealing::step(void)
 {
     bool accepted = false;
+    Move *move = &candidate;
+    const MoveBatch *batch = &neighbour_search->batch;
+    int n = neighbour_search->search_batch(batch_size);
     
-    Move *move = neighbour_search->search(iter_ant);
-
-    if (move != NULL) {
+    for (int i = 0; i < n && !accepted; i++) {
         iteration++;
-        if (move->valid) {
+        if (batch->valid[i]) {
             // valid move
+            neighbour_search->get_move(i, move);
             if(acceptable(move)) {
                 accept(move);
                 accepted = true;
                 
-                if (tabu_flag) {
+                if (instance->config.tabu_flag) {
                     update_tabu_list(move);
                 }
 //                write_anneal_report(instance, iter_ant, move);
                 
                 DEBUG(assert(check_solution(instance, iter_ant->tour, iter_ant->tour_size));)
             } else {
-                accepted = false;
                 reject(move);
             }
             
             epoch_counter++;
             if (epoch_counter >= epoch_length) {
-                epoch_counter = 0;
-                t = t * alpha;
-                
-                float ar = accept_cnt / (float) test_cnt;
-                float ir = improvement_cnt / (float) test_cnt;
-                DEBUG(printf("Time: %f, T: %f, ar: %f, ir: %f moves:%ld\n", elapsed_time(REAL), t, ar, ir, test_cnt);)
-                test_cnt = accept_cnt = improvement_cnt = 0;
+                cool();
             }
         }
     }
-    delete move;
     return accepted;
 }
 
@@ -152,7 +201,7 @@ bool SimulatedAnnealing::acceptable(Move *move)
     test_cnt++;
     double delta = move->gain;
     
-    if (tabu_flag) {
+    if (instance->config.tabu_flag) {
         // this move is in tabu list
         if (is_tabu(move)) {
             return false;
@@ -162,11 +211,11 @@ bool SimulatedAnnealing::acceptable(Move *move)
     if (delta < -EPSILON) {
         accepted = true;
         improvement_cnt++;
-        //        printf("Time: %f, T: %f, improvement: %ld\n", elapsed_time(REAL), t, delta);
+        //        printf("Time: %f, T: %f, improvement: %ld\n", elapsed_run_time(instance), t, delta);
     } else if (fabs(delta) < EPSILON) {
         accepted = true;
     }else {
-        accepted = ran01(&instance->rnd_seed) < exp(-delta / t);
+        accepted = rng_uniform(&rng) < exp(-delta / t);
     }
     
     if (accepted){
@@ -182,15 +231,16 @@ bool SimulatedAnnealing::acceptable(Move *move)
 void SimulatedAnnealing::accept(Move *move)
 {
     // apply this neighbourhood move
-    move->apply();
+    neighbour_search->apply(move);
     
-    // seem to have worse performance
-//    local_search->do_local_search(iter_ant);
+    // 每次接受移动后再做local search, seem to have worse performance
     
     if (iter_ant->tour_length - best_ant->tour_length < -EPSILON) {
         AntColony::copy_solution_from_to(iter_ant, best_ant);
         // update pheromone
-        ant_colony->global_update_pheromone_weighted(iter_ant, 2 * ras_ranks);
+        if (ant_colony != NULL) {
+            ant_colony->global_update_pheromone_weighted(iter_ant, 2 * instance->config.ras_ranks);
+        }
         printf("[%d]SA better solution. length:%f, sa_iter:%d\n", instance->pid,iter_ant->tour_length, iteration);
     }
 }
@@ -204,9 +254,33 @@ void SimulatedAnnealing::reject(Move *move)
 }
 
 
+/*
+ * 清空禁忌表
+ */
+void SimulatedAnnealing::init_tabu_list(void)
+{
+    tabu_first = 0;
+    tabu_count = 0;
+    for (int i = 0; i <= tabu_mask; i++) {
+        tabu_buckets[i] = -1;
+    }
+}
+
+int SimulatedAnnealing::tabu_bucket(MoveType type, int pos_n1, int pos_n2)
+{
+    unsigned int h = (unsigned int)type;
+    
+    h = h * 0x9e3779b1u + (unsigned int)pos_n1;
+    h = h * 0x9e3779b1u + (unsigned int)pos_n2;
+    return (int)((h ^ (h >> 15)) & tabu_mask);
+}
+
+/*
+ * move 是否是禁忌表中某个移动的逆移动: 同类型、同位置(insertion为互换的位置)且增益相反
+ */
 bool SimulatedAnnealing::is_tabu(Move *move)
 {
-    Move *tabu_move;
+    Tabu *tabu;
     int i;
     int pos_n1, pos_n2;
     
@@ -217,13 +291,13 @@ bool SimulatedAnnealing::is_tabu(Move *move)
         pos_n2 = move->pos_n1;
     }
     
-    for (i = 0; i < tabu_list.size(); i++) {
-        tabu_move = &tabu_list[i].move;
-        if (tabu_move->type == move->type &&
-            tabu_move->pos_n1 == pos_n1 &&
-            tabu_move->pos_n2 == pos_n2 &&
-            fabs(tabu_move->gain + move->gain) < EPSILON &&
-            tabu_list[i].life > iteration)
+    for (i = tabu_buckets[tabu_bucket(move->type, pos_n1, pos_n2)]; i >= 0; i = tabu->next) {
+        tabu = &tabu_ring[i];
+        if (tabu->move.type == move->type &&
+            tabu->move.pos_n1 == pos_n1 &&
+            tabu->move.pos_n2 == pos_n2 &&
+            fabs(tabu->move.gain + move->gain) < EPSILON &&
+            tabu->life > iteration)
         {
             return true;
         }
@@ -231,13 +305,34 @@ bool SimulatedAnnealing::is_tabu(Move *move)
     return false;
 }
 
+/*
+ * 删除过期的项, 再将 move 加入禁忌表
+ */
 void SimulatedAnnealing::update_tabu_list(Move *move)
 {
-    Tabu tabu(*move, iteration + TABU_LENGTH);
-    tabu_list.push_back(tabu);
+    Tabu *tabu;
+    int *link;
+    int i, b;
     
-    vector<Tabu>::iterator ibeg = tabu_list.begin();
-    while (ibeg->life <= iteration) {
-        tabu_list.erase(ibeg);
+    /* 项按life递增排列, 从最早的开始删除, 直到留出空位且没有过期的项 */
+    while (tabu_count > 0 &&
+           (tabu_count == tabu_capacity || tabu_ring[tabu_first].life <= iteration)) {
+        tabu = &tabu_ring[tabu_first];
+        link = &tabu_buckets[tabu_bucket(tabu->move.type, tabu->move.pos_n1, tabu->move.pos_n2)];
+        while (*link != tabu_first) {
+            link = &tabu_ring[*link].next;
+        }
+        *link = tabu->next;
+        tabu_first = (tabu_first + 1) % tabu_capacity;
+        tabu_count--;
     }
+    
+    i = (tabu_first + tabu_count) % tabu_capacity;
+    b = tabu_bucket(move->type, move->pos_n1, move->pos_n2);
+    tabu = &tabu_ring[i];
+    tabu->move = *move;
+    tabu->life = iteration + instance->config.tabu_tenure;
+    tabu->next = tabu_buckets[b];
+    tabu_buckets[b] = i;
+    tabu_count++;
 }
@@ -15,12 +15,14 @@
 #include "neighbourSearch.h"
 #include "antColony.h"
 
-#define TABU_LENGTH  3
-
+/*
+ * 禁忌表的一项. 所有项存放在环形缓冲区中(按加入的先后, 即按life递增),
+ * 并按 (type, pos_n1, pos_n2) 散列到桶中, 同一个桶中的项用next串成链表
+ */
 struct Tabu {
-    Tabu(Move move_, int life_):move(move_), life(life_){}
     Move move;
-    int life;   /* tabu life */
+    int life;   /* tabu life, iteration < life 时有效 */
+    int next;   /* 同一个桶中的下一项在环形缓冲区中的位置, -1 表示没有 */
 };
 
 class SimulatedAnnealing {
@@ -30,21 +32,36 @@ public:
     ~SimulatedAnnealing();
     void run(void);
     bool step(void);
+    void run_epoch(void);
+    void commit_best(void);
+    
+    /* 供 ParallelTempering 使用 */
+    double get_temperature(void) const { return t; }
+    void set_temperature(double t) { this->t = t; }
+    double current_length(void) const { return iter_ant->tour_length; }
+    AntStruct *get_best_ant(void) const { return best_ant; }
     
 private:
     Problem *instance;
+    Rng rng;                    /* 私有的随机数流, 多个replica可以在不同线程中同时退火 */
     AntStruct *best_ant;
     AntStruct *iter_ant;
-    AntColony *ant_colony;
+    AntColony *ant_colony;      /* 找到更好的解时更新其信息素; 为NULL时由调用者负责 */
     NeighbourSearch *neighbour_search;
-    LocalSearch *local_search;
-    vector<Tabu> tabu_list;
+    Move candidate;             /* 每一步生成的移动, 预先分配 */
+    Tabu *tabu_ring;            /* 环形缓冲区, 最多容纳 tabu_tenure 项 */
+    int tabu_capacity;
+    int tabu_first;             /* 最早加入的项 */
+    int tabu_count;
+    int *tabu_buckets;          /* 各桶链表的第一项, -1 表示空 */
+    int tabu_mask;              /* 桶数 - 1, 桶数为2的幂 */
     double alpha;
     double t0;
     double t;
     int iteration;
     int epoch_length;
     int epoch_counter;
+    int batch_size;             /* 每步采样的候选移动数, 随接受率调整 */
     int terminal_ratio;
     
     // 用于统计
@@ -52,11 +69,14 @@ private:
     int improvement_cnt;
     int accept_cnt;
     
+    void cool(void);
     bool acceptable(Move *move);
     void accept(Move *move);
     void reject(Move *move);
     
     // tabu list
+    void init_tabu_list(void);
+    int tabu_bucket(MoveType type, int pos_n1, int pos_n2);
     bool is_tabu(Move *move);
     void update_tabu_list(Move *move);
     
@@ -0,0 +1,145 @@
+/*********************************
+
+ Ant Colony Optimization algorithms (AS, ACS, EAS, RAS, MMAS) for CVRP
+
+ Created by 孙晓奇 on 2016/10/8.
+ Copyright © 2016年 xiaoqi.sxq. All rights reserved.
+
+ Program's name: acovrp
+ Purpose: fixed size pool of long-lived worker threads
+
+ email: sunxq1991@gmail.com
+
+ *********************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "threadPool.h"
+
+/*
+ FUNCTION:       create num_threads worker threads waiting for tasks
+ INPUT:          number of threads
+ OUTPUT:         none
+ */
+ThreadPool::ThreadPool(int num_threads)
+{
+    int i;
+
+    this->num_threads = num_threads;
+    next_task = 0;
+    pending = 0;
+    stop = false;
+
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&task_cond, NULL);
+    pthread_cond_init(&done_cond, NULL);
+
+    tids = new pthread_t[num_threads];
+    for (i = 0; i < num_threads; i++) {
+        int ret = pthread_create(&tids[i], NULL, worker_loop, (void *)this);
+        if(ret) {
+            printf("create pthread error!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/*
+ FUNCTION:       let the threads finish the remaining tasks and exit
+ */
+ThreadPool::~ThreadPool()
+{
+    int i;
+
+    pthread_mutex_lock(&mutex);
+    stop = true;
+    pthread_cond_broadcast(&task_cond);
+    pthread_mutex_unlock(&mutex);
+
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    delete[] tids;
+
+    pthread_cond_destroy(&done_cond);
+    pthread_cond_destroy(&task_cond);
+    pthread_mutex_destroy(&mutex);
+}
+
+/*
+ FUNCTION:       add a task to the queue
+ INPUT:          thread function and its argument
+ OUTPUT:         none
+ */
+void ThreadPool::submit(void *(*func)(void *), void *arg)
+{
+    Task task;
+
+    task.func = func;
+    task.arg = arg;
+
+    pthread_mutex_lock(&mutex);
+    tasks.push_back(task);
+    pending++;
+    pthread_cond_signal(&task_cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+/*
+ FUNCTION:       block until all submitted tasks are done
+ INPUT:          none
+ OUTPUT:         none
+ */
+void ThreadPool::wait(void)
+{
+    pthread_mutex_lock(&mutex);
+    while (pending > 0) {
+        pthread_cond_wait(&done_cond, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+/*
+ FUNCTION:       check without blocking whether submitted tasks are still running
+ INPUT:          none
+ OUTPUT:         true if some task is not done yet
+ */
+bool ThreadPool::busy(void)
+{
+    bool ret;
+    
+    pthread_mutex_lock(&mutex);
+    ret = pending > 0;
+    pthread_mutex_unlock(&mutex);
+    return ret;
+}
+
+void *ThreadPool::worker_loop(void *in)
+{
+    ThreadPool *pool = (ThreadPool *)in;
+    Task task;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->stop && pool->next_task == (int)pool->tasks.size()) {
+            pthread_cond_wait(&pool->task_cond, &pool->mutex);
+        }
+        if (pool->next_task == (int)pool->tasks.size()) {
+            break;      /* stop 且没有剩余任务 */
+        }
+        task = pool->tasks[pool->next_task++];
+        pthread_mutex_unlock(&pool->mutex);
+
+        task.func(task.arg);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->pending == 0) {
+            pool->tasks.clear();
+            pool->next_task = 0;
+            pthread_cond_broadcast(&pool->done_cond);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
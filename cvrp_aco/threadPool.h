@@ -0,0 +1,56 @@
+/*********************************
+
+ Ant Colony Optimization algorithms (AS, ACS, EAS, RAS, MMAS) for CVRP
+
+ Created by 孙晓奇 on 2016/10/8.
+ Copyright © 2016年 xiaoqi.sxq. All rights reserved.
+
+ Program's name: acovrp
+ Purpose: fixed size pool of long-lived worker threads
+
+ email: sunxq1991@gmail.com
+
+ *********************************/
+
+#ifndef threadPool_h
+#define threadPool_h
+
+#include <pthread.h>
+#include <vector>
+
+using namespace std;
+
+/*
+ * 线程在构造时创建, 析构时退出, 避免每次迭代都 pthread_create/pthread_join.
+ * 使用方式: 多次 submit 提交任务, 然后 wait 等待所有已提交任务完成(barrier).
+ */
+class ThreadPool {
+public:
+    ThreadPool(int num_threads);
+    ~ThreadPool();
+
+    void submit(void *(*func)(void *), void *arg);
+    void wait(void);
+    bool busy(void);
+    int size(void) const { return num_threads; }
+
+private:
+    struct Task {
+        void *(*func)(void *);
+        void *arg;
+    };
+
+    int num_threads;
+    pthread_t *tids;
+    pthread_mutex_t mutex;
+    pthread_cond_t task_cond;       /* 有新任务或需要退出 */
+    pthread_cond_t done_cond;       /* 所有任务已完成 */
+    vector<Task> tasks;             /* 任务队列, 全部完成后清空, 容量保留 */
+    int next_task;                  /* 下一个待执行任务 */
+    int pending;                    /* 已提交但未完成的任务数 */
+    bool stop;
+
+    static void *worker_loop(void *in);
+};
+
+#endif /* threadPool_h */
@@ -55,4 +55,6 @@ typedef enum type_timer {REAL, VIRTUAL} TIMER_TYPE;
 
 void start_timers(void);
 double elapsed_time(TIMER_TYPE type);
-char* get_format_time(void);
+double real_clock(void);
+double coarse_clock(void);
+char* get_format_time(char *buf);
@@ -26,7 +26,6 @@
 
 
 static double virtual_time, real_time;
-static char format_time[26];
 
 
 void start_timers(void)
@@ -84,16 +83,57 @@ double elapsed_time(TIMER_TYPE type)
 }
 
 
-char* get_format_time(void)
+double real_clock(void)
+/*    
+      FUNCTION:       return the current real time in seconds, used by callers
+                      that keep their own start time (e.g. concurrent tries)
+      INPUT:          none
+      OUTPUT:         seconds since the epoch
+      (SIDE)EFFECTS:  none
+*/
+{
+    struct timeval tp;
+    
+    gettimeofday( &tp, NULL );
+    return( (double) tp.tv_sec + (double) tp.tv_usec / 1000000.0 );
+}
+
+
+double coarse_clock(void)
+/*    
+      FUNCTION:       return a monotonic time in seconds with a resolution of a
+                      few milliseconds, cheap enough to be read in inner loops
+      INPUT:          none
+      OUTPUT:         seconds since an unspecified starting point
+      (SIDE)EFFECTS:  none
+*/
+{
+    struct timespec tp;
+    
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime( CLOCK_MONOTONIC_COARSE, &tp );
+#else
+    clock_gettime( CLOCK_MONOTONIC, &tp );
+#endif
+    return( (double) tp.tv_sec + (double) tp.tv_nsec / 1000000000.0 );
+}
+
+
+char* get_format_time(char *buf)
+/*    
+      FUNCTION:       format the current local time into buf (at least 26 chars)
+      INPUT:          output buffer
+      OUTPUT:         buf
+*/
 {
     time_t timer;
-    struct tm* tm_info;
+    struct tm tm_info;
     
     time(&timer);
-    tm_info = localtime(&timer);
+    localtime_r(&timer, &tm_info);
     
-    strftime(format_time, 26, "%Y-%m-%d %H:%M:%S", tm_info);
-    return format_time;
+    strftime(buf, 26, "%Y-%m-%d %H:%M:%S", &tm_info);
+    return buf;
 }
 
 
@@ -17,6 +17,7 @@ email: sunxq1991@gmail.com
 #include <limits.h>
 #include <assert.h>
 #include <vector>
+#include <algorithm>
 
 #include "vrpHelper.h"
 #include "utilities.h"
@@ -157,7 +158,7 @@ int att_distance (Point *nodeptr, int i, int j)
     return dij;
 }
 
-double **compute_distances(Problem *instance)
+real_t **compute_distances(Problem *instance)
 /*    
       FUNCTION: computes the matrix of all intercity distances
       INPUT:    none
@@ -165,17 +166,17 @@ double **compute_distances(Problem *instance)
 */
 {
     int     i, j;
-    double     **matrix;
+    real_t     **matrix;
     int num_node = instance->num_node;
 
-    if((matrix = (double **)malloc(sizeof(double) * num_node * num_node +
-                                     sizeof(double *) * num_node)) == NULL){
+    if((matrix = (real_t **)malloc(sizeof(real_t) * num_node * num_node +
+                                     sizeof(real_t *) * num_node)) == NULL){
         fprintf(stderr,"Out of memory, exit.");
         exit(1);
     }
 
     for ( i = 0 ; i < num_node ; i++ ) {
-        matrix[i] = (double *)(matrix + num_node) + i*num_node;
+        matrix[i] = (real_t *)(matrix + num_node) + i*num_node;
         for ( j = 0  ; j < num_node ; j++ ) {
             matrix[i][j] = distance(instance->nodeptr, i, j, instance->dis_type);
         }
@@ -185,54 +186,217 @@ double **compute_distances(Problem *instance)
 
 
 
-int ** compute_nn_lists (Problem *instance)
+void compute_heuristic(Problem *instance)
+/*    
+      FUNCTION: computes heuristic information to the power of beta for each arc
+      INPUT:    none
+      OUTPUT:   none
+      (SIDE)EFFECTS: instance->heuristic holds the heuristic of the arcs in
+                instance->arcs
+      COMMENTS: it only depends on the distances, so it is computed once per
+                instance and total information costs one multiply per arc
+*/
+{
+    int     i, j, c;
+    double     h;
+    real_t     *values = instance->heuristic;
+    DistanceMatrix &distance = instance->distance;
+    ArcLayout  *arcs = &instance->arcs;
+    
+    for ( i = 0 ; i < arcs->num_node ; i++ ) {
+        for ( c = 0  ; c < arcs->width ; c++ ) {
+            j = arcs->node(i, c);
+            h = HEURISTIC(i,j);
+            if (instance->config.beta == 2.0) {
+                h = h * h;
+            } else if (instance->config.beta != 1.0) {
+                h = pow(h, instance->config.beta);
+            }
+            values[i * arcs->width + c] = h;
+        }
+    }
+}
+
+
+
+int nn_list_depth (Problem *instance)
+/*    
+      FUNCTION: depth of the nearest neighbor lists
+      INPUT:    none
+      OUTPUT:   number of neighbours kept for each node
+*/
+{
+    int nn = MAX(MAX(instance->nn_ls, instance->nn_ants), instance->nn_ext);
+    if ( nn > instance->num_node - 2) {
+        nn = MAX(instance->num_node - 2, 0);     /* 不包括depot和自身 */
+    }
+    return nn;
+}
+
+
+
+/*
+ * 将点i插入到node的近邻列表nearest(按距离升序, 当前长度*k, 最大长度nn)中,
+ * 列表已满时挤出末尾最远的点; 距离相等的点保持插入顺序
+ */
+static void insert_nearest(int *nearest, int *k, int nn, const DistanceMatrix &distance, int node, int i)
+{
+    int pos;
+    double d;
+    
+    /* 近邻列表为空(如只有两个点的实例) */
+    if (nn == 0) {
+        return;
+    }
+    d = distance(node, i);
+    if (*k == nn && d >= distance(node, nearest[nn-1])) {
+        return;
+    }
+    if (*k < nn) {
+        (*k)++;
+    }
+    pos = *k - 1;
+    while (pos > 0 && distance(node, nearest[pos-1]) > d) {
+        nearest[pos] = nearest[pos-1];
+        pos--;
+    }
+    nearest[pos] = i;
+}
+
+void compute_nn_lists (Problem *instance)
 /*    
       FUNCTION: computes nearest neighbor lists of depth nn for each node
       INPUT:    none
-      OUTPUT:   pointer to the nearest neighbor lists
+      OUTPUT:   none
+      (SIDE)EFFECTS: instance->nn_list holds the nearest neighbor lists, its
+                rows are laid out for the current num_node
+      COMMENTS: the lists are filled by insertion in place, so no additional
+                memory is needed; nodes at equal distance keep increasing order
 */
 {
-    int i, node, nn;
-    double *distance_vector;
-    int *help_vector;
-    int **m_nnear;
+    int i, k, node, nn;
+    int **m_nnear = instance->nn_list;
     int num_node = instance->num_node;
  
     TRACE ( printf("\n computing nearest neighbor lists, "); )
 
-    nn = MAX(instance->nn_ls, instance->nn_ants);
-    if ( nn >= num_node) {
-        nn = num_node - 1;
-    }
+    nn = nn_list_depth(instance);
     DEBUG ( assert( num_node > nn ); )
     
     TRACE ( printf("nn = %ld ... \n",nn); ) 
 
-    if((m_nnear = (int **)malloc(sizeof(int) * num_node * nn
-                                      + num_node * sizeof(int *))) == NULL){
-        exit(EXIT_FAILURE);
-    }
-    distance_vector = (double *)calloc(num_node, sizeof(double));
-    help_vector = (int *)calloc(num_node, sizeof(int));
- 
     for ( node = 0 ; node < num_node ; node++ ) {  /* compute cnd-sets for all node */
-        m_nnear[node] = (int *)(m_nnear + num_node) + node * nn;
+        m_nnear[node] = (int *)(m_nnear + instance->capacity) + node * nn;
+        k = 0;
+        for ( i = 1 ; i < num_node ; i++ ) {   /* depot点需要排除在 nearest neighbour之外 */
+            if (i != node) {                   /* node is not nearest neighbour */
+                insert_nearest(m_nnear[node], &k, nn, instance->distance, node, i);
+            }
+        }
+    }
+    TRACE ( printf("\n    .. done\n"); )
+}
 
-        for ( i = 0 ; i < num_node ; i++ ) {  /* Copy distances from nodes to the others */
-            distance_vector[i] = instance->distance[node][i];
-            help_vector[i] = i;
+
+void compute_sub_nn_lists (Problem *master, Problem *sub)
+/*    
+      FUNCTION: computes the nearest neighbor lists of a sub-problem from the
+                lists of the master problem
+      INPUT:    master problem, sub-problem with real_nodes set up
+      OUTPUT:   none
+      (SIDE)EFFECTS: sub->nn_list holds the nearest neighbor lists
+      COMMENTS: the master lists are sorted by distance, so keeping the sub
+                nodes in order gives the sub lists. Only if a master list is
+                too short, the remaining sub nodes (all farther away than the
+                master list) are added by insertion
+*/
+{
+    int i, j, c, k, tail, node, rnode, nn, master_nn;
+    int **m_nnear = sub->nn_list;
+    int *nearest, *m_near;
+    int *sub_index = master->sub_index;
+    const int *real_nodes = &sub->real_nodes[0];
+    int num_node = sub->num_node;
+    bool complete;
+    
+    nn = nn_list_depth(sub);
+    master_nn = nn_list_depth(master);
+    /* 主问题近邻列表包含所有点时, 筛选结果一定完整 */
+    complete = master_nn >= master->num_node - 2;
+    
+    for (i = 0; i < num_node; i++) {
+        sub_index[real_nodes[i]] = i;
+    }
+    
+    for ( node = 0 ; node < num_node ; node++ ) {
+        m_nnear[node] = (int *)(m_nnear + sub->capacity) + node * nn;
+        nearest = m_nnear[node];
+        rnode = real_nodes[node];
+        m_near = master->nn_list[rnode];
+        
+        k = 0;
+        for ( c = 0 ; c < master_nn && k < nn ; c++ ) {
+            j = sub_index[m_near[c]];
+            if (j > 0) {        /* depot 不在主问题近邻列表中 */
+                nearest[k++] = j;
+            }
         }
-        distance_vector[node] = INFINITY;  /* node is not nearest neighbour */
-        distance_vector[0] = INFINITY;     /* depot点需要排除在 nearest neighbour之外 */
-        sort2(distance_vector, help_vector, 0, num_node-1);
-        for ( i = 0 ; i < nn ; i++ ) {
-            m_nnear[node][i] = help_vector[i];
+        if (k == nn || complete) {
+            continue;
+        }
+        
+        /* 主问题列表不够长: 标记已选中的点(编码为负数), 其余子问题的点按距离补充 */
+        for ( c = 0 ; c < k ; c++ ) {
+            sub_index[real_nodes[nearest[c]]] = -2 - nearest[c];
+        }
+        tail = 0;
+        for ( i = 1 ; i < num_node ; i++ ) {
+            if (i != node && sub_index[real_nodes[i]] >= 0) {
+                insert_nearest(nearest + k, &tail, nn - k, sub->distance, node, i);
+            }
+        }
+        DEBUG ( assert( k + tail == nn ); )
+        for ( c = 0 ; c < k ; c++ ) {
+            sub_index[real_nodes[nearest[c]]] = nearest[c];
         }
     }
-    free(distance_vector);
-    free(help_vector);
-    TRACE ( printf("\n    .. done\n"); )
-    return m_nnear;
+    
+    for (i = 0; i < num_node; i++) {
+        sub_index[real_nodes[i]] = -1;
+    }
+}
+
+
+/* 按需求量比较两个配送点 */
+struct DemandLess {
+    Point *nodeptr;
+    DemandLess(Point *p): nodeptr(p) {}
+    bool operator()(int a, int b) const {
+        return nodeptr[a].demand < nodeptr[b].demand
+            || (nodeptr[a].demand == nodeptr[b].demand && a < b);
+    }
+};
+
+void compute_demand_order (Problem *instance)
+/*    
+      FUNCTION: sorts all nodes except the depot by increasing demand
+      INPUT:    none
+      OUTPUT:   none
+      (SIDE)EFFECTS: instance->demand holds the demand of every node,
+                instance->demand_order holds the sorted nodes
+*/
+{
+    int i;
+    int *order = instance->demand_order;
+    int num_node = instance->num_node;
+    
+    for ( i = 0 ; i < num_node ; i++ ) {
+        instance->demand[i] = instance->nodeptr[i].demand;
+    }
+    for ( i = 1 ; i < num_node ; i++ ) {
+        order[i-1] = i;
+    }
+    sort(order, order + num_node - 1, DemandLess(instance->nodeptr));
 }
 
 
@@ -247,7 +411,7 @@ double compute_tour_length(Problem *instance, int *tour, int tour_size)
     double   tour_length = 0;
   
     for ( i = 0 ; i < tour_size-1; i++ ) {
-        tour_length += instance->distance[tour[i]][tour[i+1]];
+        tour_length += instance->distance(tour[i], tour[i+1]);
     }
     return tour_length;
 }
@@ -261,7 +425,7 @@ double compute_route_length(Problem *instance, int *route, int route_size)
     double   route_length = 0;
     
     for ( i = 0 ; i < route_size-1; i++ ) {
-        route_length += instance->distance[route[i]][route[i+1]];
+        route_length += instance->distance(route[i], route[i+1]);
     }
     return route_length;
 }
@@ -278,9 +442,10 @@ void compute_route_centers(Problem *instance, int *tour, const vector<RouteCente
     
     int i, j;
     for (i = 0; i < centers.size(); i++) {
-        cp = new Point();
+        cp = centers[i]->coord;     /* 由调用者分配, 重复使用 */
         cp->x = 0;
         cp->y = 0;
+        cp->demand = 0;
         for (j = centers[i]->beg; j < centers[i]->end; j++) {
             cp->demand += nodeptr[tour[j]].demand;
         }
@@ -289,7 +454,6 @@ void compute_route_centers(Problem *instance, int *tour, const vector<RouteCente
             cp->x += nodeptr[tour[j]].x * nodeptr[tour[j]].demand * 1.0 / cp->demand;
             cp->y += nodeptr[tour[j]].y * nodeptr[tour[j]].demand * 1.0 / cp->demand;
         }
-        centers[i]->coord = cp;
     }
 }
 
@@ -18,6 +18,10 @@
 #include "problem.h"
 
 #define RRR            6378.388
+#define HEURISTIC(m,n)     (1.0 / ((double) distance(m, n) + 0.1))
+/* add a small constant to avoid division by zero if a distance is
+ zero */
+
 #ifndef PI             /* as in stroustrup */
 #define PI             3.14159265358979323846
 #endif
@@ -25,8 +29,12 @@
 
 double compute_tour_length(Problem *instance, int *t, int t_sz);
 double compute_route_length(Problem *instance, int *route, int route_size);
-double **compute_distances(Problem *instance);
-int ** compute_nn_lists (Problem *instance);
+real_t **compute_distances(Problem *instance);
+void compute_heuristic(Problem *instance);
+int nn_list_depth(Problem *instance);
+void compute_nn_lists (Problem *instance);
+void compute_sub_nn_lists (Problem *master, Problem *sub);
+void compute_demand_order (Problem *instance);
 void compute_route_centers(Problem *instance, int *tour, const vector<RouteCenter *>& centers);
 
 #endif